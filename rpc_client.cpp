@@ -2,6 +2,7 @@
 #include <cstring>
 
 #include "rpc_client.h"
+#include "rpc_client_loop.h"
 
 
 using namespace std;
@@ -32,6 +33,7 @@ SockRpc
 {
     request = ParamList::create();
     answer = ParamList::create();
+    pendingAnswer = ParamList::create();
 }
 
 
@@ -49,6 +51,7 @@ RpcClient::~RpcClient()
     {
         answer -> destroy();
     }
+    pendingAnswer -> destroy();
 }
 
 
@@ -117,13 +120,55 @@ RpcClient* RpcClient::call()
             onBeforeCall( this );
         }
 
-        connect();
+        /* Expired request is not sent */
+        auto budget = getBudget();
+        if( budget == 0 )
+        {
+            setCode( RPC_DEADLINE_EXCEEDED );
+        }
+        else
+        {
+            connect();
+        }
+
         if( isOk() )
         {
-            if( request != NULL )
+            if( typedRequest != NULL )
+            {
+                /* Typed request needs method id of v2 header */
+                auto header = SockRpcHeader::create(( size_t ) 0, RPC_VERSION_2 );
+                header.requestId = ++lastRequestId;
+                header.methodId = callMethodId;
+                header.flags |= RPC_FLAG_TYPED;
+                header.setDeadline( max( budget, 0LL ));
+                if( serverCompression )
+                {
+                    header.flags |= RPC_FLAG_COMPRESSED;
+                }
+
+                writePayload
+                (
+                    typedRequest -> data(),
+                    typedRequest -> size(),
+                    -1,
+                    header
+                );
+                clientRead();
+            }
+            else if( request != NULL )
             {
+                /* Request header, ids are used by v2 only */
+                auto header = SockRpcHeader::create( 0, getRpcVersion() );
+                header.requestId = ++lastRequestId;
+                header.methodId = callMethodId;
+                header.setDeadline( max( budget, 0LL ));
+                if( serverCompression )
+                {
+                    header.flags |= RPC_FLAG_COMPRESSED;
+                }
+
                 /* Send buffer to server */
-                write( request );
+                write( request, -1, header );
                 /* Read answer from server */
                 clientRead();
             }
@@ -143,6 +188,48 @@ RpcClient* RpcClient::call()
 
 
 
+/*
+    Return budget of the next request in mcs
+*/
+long long RpcClient::getBudget()
+{
+    auto result = getCallBudget();
+    if
+    (
+        deadlineMcs > 0 &&
+        ( result < 0 || ( long long ) deadlineMcs < result )
+    )
+    {
+        result = deadlineMcs;
+    }
+    return result;
+}
+
+
+
+/*
+    Call method by name on the server
+*/
+RpcClient* RpcClient::callRemote
+(
+    string aMethod
+)
+{
+    /* Expected answer size for adaptive packet size */
+    auto& sizes = methodSizes[ aMethod ];
+    setPacketSizeHint( sizes.average );
+
+    answerSize = 0;
+    call();
+    if( answerSize > 0 )
+    {
+        sizes.add( answerSize );
+    }
+    return this;
+}
+
+
+
 RpcClient* RpcClient::call
 (
     string aMethod
@@ -151,7 +238,96 @@ RpcClient* RpcClient::call
     if( isOk() )
     {
         request -> setString( "method", aMethod );
-        call();
+
+        /*
+            Server id and serialized request are the key of the cache
+            and coalescer, clients of other servers may share them
+        */
+        string requestKey = "";
+        bool cacheable = cache != NULL && cache -> isCached( aMethod );
+        if( cacheable || coalescer != NULL )
+        {
+            void* buffer = NULL;
+            size_t size = 0;
+            request -> toBuffer( buffer, size );
+            requestKey
+            .assign( getId() )
+            .append( 1, '\0' )
+            .append(( char* ) buffer, size );
+            ::operator delete( buffer );
+        }
+
+        /* Serialized answer of the cache or of the call of other thread */
+        string sharedAnswer = "";
+        bool shared = cacheable && cache -> get( aMethod, requestKey, sharedAnswer );
+
+        if( !shared && coalescer != NULL )
+        {
+            /* The same calls of other threads wait for this one */
+            string sharedCode = "";
+            shared = coalescer -> run
+            (
+                requestKey,
+                [ this, &aMethod ]( string& aCode, string& aAnswer )
+                {
+                    callRemote( aMethod );
+                    aCode = getCode();
+                    if( isOk() )
+                    {
+                        void* buffer = NULL;
+                        size_t size = 0;
+                        getAnswer() -> toBuffer( buffer, size );
+                        aAnswer.assign(( char* ) buffer, size );
+                        ::operator delete( buffer );
+                    }
+                },
+                sharedCode,
+                sharedAnswer
+            );
+            if( shared && sharedCode != "ok" )
+            {
+                setCode( sharedCode );
+            }
+        }
+        else if( !shared )
+        {
+            callRemote( aMethod );
+        }
+
+        if( shared )
+        {
+            if( isOk() )
+            {
+                getAnswer()
+                -> clear()
+                -> fromBuffer(( void* ) sharedAnswer.data(), sharedAnswer.size() );
+            }
+        }
+        else if
+        (
+            cacheable &&
+            isOk() &&
+            getAnswer() -> getString( Path{ "result", "code" }) == "ok"
+        )
+        {
+            /* Leader of the coalescer has serialized the answer already */
+            if( sharedAnswer == "" )
+            {
+                void* buffer = NULL;
+                size_t size = 0;
+                getAnswer() -> toBuffer( buffer, size );
+                sharedAnswer.assign(( char* ) buffer, size );
+                ::operator delete( buffer );
+            }
+            cache -> put
+            (
+                aMethod,
+                requestKey,
+                sharedAnswer.data(),
+                sharedAnswer.size()
+            );
+        }
+
         if( isOk() )
         {
             /* Result code processing */
@@ -191,7 +367,9 @@ RpcClient* RpcClient::call
     if( isOk() )
     {
         request -> setInt( "method", aMethod );
+        callMethodId = aMethod;
         call();
+        callMethodId = 0;
         if( isOk() )
         {
             /* Result code processing */
@@ -214,6 +392,433 @@ RpcClient* RpcClient::call
 
 
 
+/*
+    Call method by id with typed payloads
+*/
+RpcClient* RpcClient::callTyped
+(
+    unsigned int    aMethodId,  /* Method ID */
+    const string&   aRequest,   /* Request */
+    string&         aAnswer     /* Answer */
+)
+{
+    if( isOk() )
+    {
+        aAnswer.clear();
+        callMethodId = aMethodId;
+        typedRequest = &aRequest;
+        typedAnswer = &aAnswer;
+        call();
+        callMethodId = 0;
+        typedRequest = NULL;
+        typedAnswer = NULL;
+
+        if( isOk() )
+        {
+            /* Result code processing */
+            auto code = getAnswer() -> getString( Path{ "result", "code" });
+            if( code == "" )
+            {
+                setCode( "UNKNOWN_RPC_CLIENT_ANSWER_CODE" );
+            }
+            else if( code != "ok" )
+            {
+                setCode( code );
+            }
+        }
+        else
+        {
+            getLog()
+            -> warning( "Rpc typed call error" )
+            -> prm( "method", ( int ) aMethodId )
+            -> prm( "code", getCode() );
+        }
+    }
+    return this;
+}
+
+
+
+/*
+    Post request without waiting for the answer
+*/
+unsigned long long RpcClient::post
+(
+    ParamList*      aRequest,   /* Request */
+    OnAnswer        aOnAnswer,  /* Answer callback */
+    unsigned int    aMethodId,  /* Method id */
+    OnChunk         aOnChunk    /* Chunk callback for streamed answer */
+)
+{
+    unsigned long long result = 0;
+
+    auto budget = getBudget();
+    if( budget == 0 )
+    {
+        setCode( RPC_DEADLINE_EXCEEDED );
+    }
+
+    if( isOk() )
+    {
+        connect();
+        if( isOk() )
+        {
+            SockRpcHeader header;
+            header.version = RPC_VERSION_2;
+            header.requestId = ++lastRequestId;
+            header.methodId = aMethodId;
+            header.setDeadline( max( budget, 0LL ));
+            if( serverCompression )
+            {
+                header.flags |= RPC_FLAG_COMPRESSED;
+            }
+
+            pending[ header.requestId ] = aOnAnswer;
+            if( aOnChunk )
+            {
+                header.flags |= RPC_FLAG_STREAM;
+                streams[ header.requestId ] = aOnChunk;
+            }
+            write( aRequest, -1, header );
+
+            if( isOk() )
+            {
+                result = header.requestId;
+            }
+            else
+            {
+                pending.erase( header.requestId );
+                streams.erase( header.requestId );
+            }
+        }
+    }
+
+    return result;
+}
+
+
+
+/*
+    Call with streamed answer
+*/
+RpcClient* RpcClient::callStream
+(
+    ParamList*      aRequest,   /* Request */
+    OnChunk         aOnChunk,   /* Chunk callback */
+    unsigned int    aMethodId   /* Method id */
+)
+{
+    auto result = answer -> clear();
+    post
+    (
+        aRequest,
+        [ result ]( ParamList* aResult, string )
+        {
+            /* Copy answer through its buffer */
+            void* buffer = NULL;
+            size_t bufferSize = 0;
+            aResult -> toBuffer( buffer, bufferSize );
+            result -> fromBuffer( buffer, bufferSize );
+            ::operator delete( buffer );
+        },
+        aMethodId,
+        aOnChunk
+    );
+    wait();
+
+    if( !isOk() )
+    {
+        disconnect();
+    }
+
+    return this;
+}
+
+
+
+/*
+    Call list of requests with one write
+*/
+RpcClient* RpcClient::callBatch
+(
+    vector <ParamList*>&    aRequests,  /* Requests */
+    vector <ParamList*>&    aAnswers,   /* Answers */
+    unsigned int            aMethodId   /* Method id */
+)
+{
+    if( aRequests.size() != aAnswers.size() )
+    {
+        setResult( "RpcBatchAnswersCount" )
+        -> getDetails()
+        -> setInt( "requests", aRequests.size() )
+        -> setInt( "answers", aAnswers.size() );
+    }
+
+    auto budget = getBudget();
+    if( budget == 0 )
+    {
+        setCode( RPC_DEADLINE_EXCEEDED );
+    }
+
+    if( isOk() )
+    {
+        connect();
+        if( isOk() )
+        {
+            vector <SockRpcHeader> headers( aRequests.size() );
+
+            for( size_t i = 0; i < aRequests.size(); i++ )
+            {
+                auto& header = headers[ i ];
+                header.version = RPC_VERSION_2;
+                header.requestId = ++lastRequestId;
+                header.methodId = aMethodId;
+                header.setDeadline( max( budget, 0LL ));
+                if( serverCompression )
+                {
+                    header.flags |= RPC_FLAG_COMPRESSED;
+                }
+
+                auto answer = aAnswers[ i ];
+                answer -> clear();
+                pending[ header.requestId ] =
+                [ answer ]( ParamList* aResult, string )
+                {
+                    /* Copy answer through its buffer */
+                    void* buffer = NULL;
+                    size_t bufferSize = 0;
+                    aResult -> toBuffer( buffer, bufferSize );
+                    answer -> fromBuffer( buffer, bufferSize );
+                    ::operator delete( buffer );
+                };
+            }
+
+            writeBatch( aRequests, headers );
+            wait();
+
+            if( !isOk() )
+            {
+                disconnect();
+            }
+        }
+    }
+
+    return this;
+}
+
+
+
+/*
+    Read answers until all posted requests are answered
+*/
+RpcClient* RpcClient::wait()
+{
+    while( isOk() && !pending.empty() )
+    {
+        clientRead();
+    }
+
+    if( !pending.empty() )
+    {
+        /* Requests without answers are failed */
+        cancel( getCode() );
+    }
+
+    return this;
+}
+
+
+
+/*
+    Fail posted requests with code and disconnect
+*/
+RpcClient* RpcClient::cancel
+(
+    string aCode
+)
+{
+    auto rest = pending;
+    pending.clear();
+    streams.clear();
+    for( auto& item : rest )
+    {
+        item.second( pendingAnswer -> clear(), aCode );
+    }
+    disconnect();
+    return this;
+}
+
+
+
+/*
+    Set loop for asynchronous calls
+*/
+RpcClient* RpcClient::setLoop
+(
+    RpcClientLoop* a
+)
+{
+    loop = a;
+    if( loop != NULL )
+    {
+        /* Request ids and answers of the client must not mix with others */
+        setOwnConnection();
+    }
+    return this;
+}
+
+
+
+/*
+    Return loop for asynchronous calls or NULL
+*/
+RpcClientLoop* RpcClient::getLoop()
+{
+    return loop;
+}
+
+
+
+/*
+    Set shared cache of results
+*/
+RpcClient* RpcClient::setCache
+(
+    RpcClientCache* a
+)
+{
+    cache = a;
+    return this;
+}
+
+
+
+/*
+    Return cache of results or NULL
+*/
+RpcClientCache* RpcClient::getCache()
+{
+    return cache;
+}
+
+
+
+/*
+    Set shared coalescer of identical calls
+*/
+RpcClient* RpcClient::setCoalescer
+(
+    RpcClientCoalescer* a
+)
+{
+    coalescer = a;
+    return this;
+}
+
+
+
+/*
+    Return coalescer of identical calls or NULL
+*/
+RpcClientCoalescer* RpcClient::getCoalescer()
+{
+    return coalescer;
+}
+
+
+
+/*
+    Set budget of requests in mcs
+*/
+RpcClient* RpcClient::setDeadline
+(
+    unsigned long long a
+)
+{
+    deadlineMcs = a;
+    return this;
+}
+
+
+
+/*
+    Return budget of requests in mcs
+*/
+unsigned long long RpcClient::getDeadline()
+{
+    return deadlineMcs;
+}
+
+
+
+/*
+    Asynchronous call
+*/
+RpcClient* RpcClient::callAsync
+(
+    ParamList*      aRequest,   /* Request */
+    OnAnswer        aOnAnswer,  /* Answer callback */
+    unsigned int    aMethodId   /* Method id */
+)
+{
+    if( loop == NULL )
+    {
+        aRequest -> destroy();
+        aOnAnswer( pendingAnswer -> clear(), "RpcClientLoopIsNotSet" );
+    }
+    else
+    {
+        loop -> push( this, aRequest, aOnAnswer, aMethodId );
+    }
+    return this;
+}
+
+
+
+/*
+    Asynchronous call with future of the result code
+*/
+future <string> RpcClient::callAsync
+(
+    ParamList*      aRequest,   /* Request */
+    ParamList*      aAnswer,    /* Answer */
+    unsigned int    aMethodId   /* Method id */
+)
+{
+    auto promise = make_shared <std::promise <string>> ();
+
+    callAsync
+    (
+        aRequest,
+        [ promise, aAnswer ]( ParamList* aResult, string aCode )
+        {
+            /* Copy answer through its buffer */
+            void* buffer = NULL;
+            size_t bufferSize = 0;
+            aResult -> toBuffer( buffer, bufferSize );
+            aAnswer -> clear() -> fromBuffer( buffer, bufferSize );
+            ::operator delete( buffer );
+
+            promise -> set_value( aCode );
+        },
+        aMethodId
+    );
+
+    return promise -> get_future();
+}
+
+
+
+/*
+    Return count of posted requests without answers
+*/
+unsigned int RpcClient::getPendingCount()
+{
+    return pending.size();
+}
+
+
+
 ParamList* RpcClient::getRequest()
 {
     return request;
@@ -228,6 +833,20 @@ ParamList* RpcClient::getAnswer()
 
 
 
+/*
+    Return answer size statistics for method
+*/
+SockSizeStat RpcClient::getMethodSizes
+(
+    string aMethod
+)
+{
+    auto item = methodSizes.find( aMethod );
+    return item == methodSizes.end() ? SockSizeStat() : item -> second;
+}
+
+
+
 
 RpcClient* RpcClient::setRequest
 (
@@ -321,13 +940,82 @@ bool RpcClient::onReadAfter
 
     auto header = SockRpcHeader::create( aBuffer );
 
+    /* Payload of the full frame, NULL if it is corrupted */
+    size_t payloadSize = 0;
+    char* payload =
+    header.isValid() && header.isFull( aBuffer )
+    ? getPayload( aBuffer, header, payloadSize )
+    : NULL;
+
+    /* Server accepts compressed requests */
     if( header.isValid() )
     {
-        auto buffer = aBuffer -> getBuffer();
-        void* pointer = &buffer[ sizeof( SockRpcHeader ) ];
+        serverCompression = header.flags & RPC_FLAG_ACCEPT_COMPRESSED;
+    }
 
-        /* Create parms from buffer */
-        answer -> clear() -> fromBuffer( pointer, header.argumentsSize );
+    auto posted = header.version == RPC_VERSION_2
+    ? pending.find( header.requestId )
+    : pending.end();
+
+    auto stream =
+    header.flags & RPC_FLAG_STREAM && !( header.flags & RPC_FLAG_STREAM_END )
+    ? streams.find( header.requestId )
+    : streams.end();
+
+    if( stream != streams.end() && payload != NULL )
+    {
+        /* Chunk of streamed answer */
+        pendingAnswer -> clear() -> fromBuffer( payload, payloadSize );
+        stream -> second( pendingAnswer );
+    }
+    else if( posted != pending.end() && header.isFull( aBuffer ))
+    {
+        /* Answer of posted request */
+        auto onAnswer = posted -> second;
+        pending.erase( posted );
+        streams.erase( header.requestId );
+
+        pendingAnswer -> clear() -> fromBuffer( payload, payloadSize );
+        onAnswer
+        (
+            pendingAnswer,
+            payload == NULL ? "RpcPayloadIsNotValid" : "ok"
+        );
+    }
+    else if
+    (
+        header.version == RPC_VERSION_2 &&
+        header.requestId != lastRequestId
+    )
+    {
+        /* Late answer of the previous call */
+        getLog()
+        -> warning( "RPC server sent answer for other request" )
+        -> prm( "requestId", ( long long ) header.requestId )
+        -> prm( "expectedRequestId", ( long long ) lastRequestId );
+    }
+    else if( header.isValid() && header.isFull( aBuffer ))
+    {
+        answerSize = aBuffer -> calcReadSize();
+
+        if( header.flags & RPC_FLAG_TYPED )
+        {
+            /* Typed answer is ok, errors come as ParamList */
+            if( typedAnswer != NULL && payload != NULL )
+            {
+                typedAnswer -> assign( payload, payloadSize );
+            }
+            answer -> clear() -> setString
+            (
+                Path{ "result", "code" },
+                payload == NULL ? "RpcPayloadIsNotValid" : "ok"
+            );
+        }
+        else
+        {
+            /* Create parms from buffer */
+            answer -> clear() -> fromBuffer( payload, payloadSize );
+        }
         onCallAfter();
     }
     else
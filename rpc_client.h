@@ -6,15 +6,24 @@
 */
 
 #include <functional>
+#include <future>
+#include <map>
 
 
 #include "sock_rpc.h"
 #include "sock_manager.h"
+#include "rpc_client_cache.h"
+#include "rpc_client_coalescer.h"
 
 #include "../json/param_list.h"
 
 
 
+/* Predeclaration of loop for asynchronous calls */
+class RpcClientLoop;
+
+
+
 /*
     Client class definition
 */
@@ -27,6 +36,19 @@ class RpcClient : public SockRpc
         typedef std::function< void ( RpcClient* )> OnBeforeCall;
         typedef std::function< void ( RpcClient* )> OnAfterCall;
 
+        /*
+            Answer of posted request
+            Answer is valid only in callback, it is empty on error.
+            Code is "ok" or transport error code.
+        */
+        typedef std::function< void ( ParamList*, string )> OnAnswer;
+
+        /*
+            Chunk of streamed answer
+            Chunk is valid only in callback
+        */
+        typedef std::function< void ( ParamList* )> OnChunk;
+
     private:
         ParamList* answer   = NULL;
         ParamList* request  = NULL;
@@ -34,6 +56,57 @@ class RpcClient : public SockRpc
         bool ownerAnswer    = true;
         bool ownerRequest   = true;
 
+        /* Ids of the current call for RPC v2 header */
+        unsigned long long  lastRequestId   = 0;
+        unsigned int        callMethodId    = 0;
+
+        /* Typed payloads of the current call, NULL for ParamList call */
+        const string*       typedRequest    = NULL;
+        string*             typedAnswer     = NULL;
+
+        /* Posted requests waiting for answers by request id */
+        map <unsigned long long, OnAnswer> pending;
+        map <unsigned long long, OnChunk> streams;
+        ParamList* pendingAnswer = NULL;
+
+        /* Server accepts compressed requests */
+        bool serverCompression = false;
+
+        /* Loop for asynchronous calls */
+        RpcClientLoop* loop = NULL;
+
+        /* Shared cache of results, not owned */
+        RpcClientCache* cache = NULL;
+
+        /* Shared coalescer of identical calls, not owned */
+        RpcClientCoalescer* coalescer = NULL;
+
+        /* Budget of requests for the server, 0 without deadline */
+        unsigned long long deadlineMcs = 0;
+
+        /* Answer sizes by method for adaptive packet size */
+        map <string, SockSizeStat> methodSizes;
+        unsigned int answerSize = 0;
+
+        /*
+            Return budget of the next request in mcs
+            It is the own deadline or the rest of the current server
+            call of the thread, -1 without deadline
+        */
+        long long getBudget();
+
+
+
+        /*
+            Call method by name on the server
+        */
+        RpcClient* callRemote
+        (
+            string  /* Method */
+        );
+
+
+
         /*
             On before read
             Method may not be overrided
@@ -146,6 +219,199 @@ class RpcClient : public SockRpc
 
 
 
+        /*
+            Call method by id with typed payloads
+            Request and answer are structs encoded by RpcTyped, error
+            of the server goes to the result code. rpcCallTyped of
+            rpc_typed.h encodes and decodes structs. Typed call uses
+            RPC v2 header.
+        */
+        RpcClient* callTyped
+        (
+            unsigned int,   /* Method ID */
+            const string&,  /* Request */
+            string&         /* Answer */
+        );
+
+
+
+        /*
+            Post request without waiting for the answer
+            Many requests may be in flight on one connection, answers
+            are matched by request id in any order. Posted requests use
+            RPC v2 header. Return request id or 0 on error.
+            Request with chunk callback asks for the streamed answer,
+            chunks come to callback before the answer.
+        */
+        unsigned long long post
+        (
+            ParamList*,         /* Request */
+            OnAnswer,           /* Answer callback */
+            unsigned int = 0,   /* Method id */
+            OnChunk = NULL      /* Chunk callback for streamed answer */
+        );
+
+
+
+        /*
+            Call with streamed answer
+            Chunks come to callback while server produces them, the
+            final answer is in getAnswer.
+        */
+        RpcClient* callStream
+        (
+            ParamList*,         /* Request */
+            OnChunk,            /* Chunk callback */
+            unsigned int = 0    /* Method id */
+        );
+
+
+
+        /*
+            Call list of requests with one write
+            Requests are written as RPC v2 frames with one send and
+            answers are read from one stream. Answers list must have
+            the same count of ParamList as requests. Answer of failed
+            request is empty.
+        */
+        RpcClient* callBatch
+        (
+            vector <ParamList*>&,   /* Requests */
+            vector <ParamList*>&,   /* Answers */
+            unsigned int = 0        /* Method id */
+        );
+
+
+
+        /*
+            Read answers until all posted requests are answered
+            On error callbacks of the rest requests are called with
+            error code
+        */
+        RpcClient* wait();
+
+
+
+        /*
+            Return count of posted requests without answers
+        */
+        unsigned int getPendingCount();
+
+
+
+        /*
+            Fail posted requests with code and disconnect
+        */
+        RpcClient* cancel
+        (
+            string  /* Code */
+        );
+
+
+
+        /*
+            Set loop for asynchronous calls
+            Client is driven by the loop thread after the first call.
+            Client gets own connection, so call it before connect.
+        */
+        RpcClient* setLoop
+        (
+            RpcClientLoop*
+        );
+
+
+
+        /*
+            Return loop for asynchronous calls or NULL
+        */
+        RpcClientLoop* getLoop();
+
+
+
+        /*
+            Set shared cache of results for call by method name
+            Cache is not owned by the client, NULL turns cache off
+        */
+        RpcClient* setCache
+        (
+            RpcClientCache*
+        );
+
+
+
+        /*
+            Return cache of results or NULL
+        */
+        RpcClientCache* getCache();
+
+
+
+        /*
+            Set shared coalescer of identical calls by method name
+            Coalescer is not owned by the client, NULL turns it off
+        */
+        RpcClient* setCoalescer
+        (
+            RpcClientCoalescer*
+        );
+
+
+
+        /*
+            Return coalescer of identical calls or NULL
+        */
+        RpcClientCoalescer* getCoalescer();
+
+
+
+        /*
+            Set budget of requests in mcs, 0 without deadline
+            Server drops requests that wait longer than the budget.
+            Calls from handlers pass the rest of the server call
+            budget when it is less. Deadline needs RPC v2.
+        */
+        RpcClient* setDeadline
+        (
+            unsigned long long
+        );
+
+
+
+        /*
+            Return budget of requests in mcs
+        */
+        unsigned long long getDeadline();
+
+
+
+        /*
+            Asynchronous call
+            Request is owned by the loop, callback is called on the
+            loop thread
+        */
+        RpcClient* callAsync
+        (
+            ParamList*,         /* Request */
+            OnAnswer,           /* Answer callback */
+            unsigned int = 0    /* Method id */
+        );
+
+
+
+        /*
+            Asynchronous call with future of the result code
+            Request is owned by the loop, answer is filled before
+            the future is ready
+        */
+        future <string> callAsync
+        (
+            ParamList*,         /* Request */
+            ParamList*,         /* Answer */
+            unsigned int = 0    /* Method id */
+        );
+
+
+
         /*
             Client on call before event
             Method may be ovverided
@@ -185,6 +451,16 @@ class RpcClient : public SockRpc
 
 
 
+        /*
+            Return answer size statistics for method
+        */
+        SockSizeStat getMethodSizes
+        (
+            string /* Method */
+        );
+
+
+
         /*
             Client On error event
         */
@@ -0,0 +1,272 @@
+#include "rpc_client_cache.h"
+#include "../core/utils.h"
+
+
+
+using namespace std;
+
+
+
+/*
+    Create cache
+*/
+RpcClientCache* RpcClientCache::create()
+{
+    return new RpcClientCache();
+}
+
+
+
+/*
+    Destroy cache
+*/
+void RpcClientCache::destroy()
+{
+    delete this;
+}
+
+
+
+/*
+    Remove entry of the method
+*/
+void RpcClientCache::remove
+(
+    RpcClientCacheMethod&                                   aMethod,
+    unordered_map <string, RpcClientCacheEntry>::iterator   aEntry
+)
+{
+    aMethod.size -= aEntry -> first.size() + aEntry -> second.answer.size();
+    aMethod.order.erase( aEntry -> second.order );
+    aMethod.entries.erase( aEntry );
+}
+
+
+
+/*
+    Set cache of the method
+*/
+RpcClientCache* RpcClientCache::setMethod
+(
+    string              aMethod,    /* Method */
+    unsigned long long  aTtlMcs,    /* TTL mcs */
+    size_t              aMaxSize    /* Limit of bytes */
+)
+{
+    lock_guard <mutex> lock( sync );
+
+    if( aTtlMcs == 0 )
+    {
+        methods.erase( aMethod );
+    }
+    else
+    {
+        auto& method = methods[ aMethod ];
+        method.ttlMcs = aTtlMcs;
+        method.maxSize = aMaxSize;
+
+        while( method.size > method.maxSize && !method.order.empty() )
+        {
+            remove( method, method.entries.find( method.order.back() ));
+        }
+    }
+
+    return this;
+}
+
+
+
+/*
+    Return true if the method is cached
+*/
+bool RpcClientCache::isCached
+(
+    string aMethod  /* Method */
+)
+{
+    lock_guard <mutex> lock( sync );
+    return methods.find( aMethod ) != methods.end();
+}
+
+
+
+/*
+    Return serialized answer for serialized request
+*/
+bool RpcClientCache::get
+(
+    string          aMethod,    /* Method */
+    const string&   aRequest,   /* Request key */
+    string&         aAnswer     /* Answer */
+)
+{
+    bool result = false;
+
+    lock_guard <mutex> lock( sync );
+
+    auto method = methods.find( aMethod );
+    if( method != methods.end() )
+    {
+        auto& cached = method -> second;
+        auto entry = cached.entries.find( aRequest );
+
+        if( entry != cached.entries.end() )
+        {
+            if( entry -> second.expire <= now() )
+            {
+                /* Entry is dead */
+                remove( cached, entry );
+            }
+            else
+            {
+                /* Entry goes to the head of LRU */
+                cached.order.splice
+                (
+                    cached.order.begin(),
+                    cached.order,
+                    entry -> second.order
+                );
+                aAnswer = entry -> second.answer;
+                result = true;
+            }
+        }
+
+        if( result )
+        {
+            cached.hitCount++;
+        }
+        else
+        {
+            cached.missCount++;
+        }
+    }
+
+    return result;
+}
+
+
+
+/*
+    Put serialized answer for serialized request
+*/
+RpcClientCache* RpcClientCache::put
+(
+    string          aMethod,        /* Method */
+    const string&   aRequest,       /* Request key */
+    const char*     aAnswer,        /* Answer */
+    size_t          aAnswerSize     /* Size of answer */
+)
+{
+    lock_guard <mutex> lock( sync );
+
+    auto method = methods.find( aMethod );
+    auto entrySize = aRequest.size() + aAnswerSize;
+
+    if( method != methods.end() && entrySize <= method -> second.maxSize )
+    {
+        auto& cached = method -> second;
+
+        /* Old entry of the request */
+        auto entry = cached.entries.find( aRequest );
+        if( entry != cached.entries.end() )
+        {
+            remove( cached, entry );
+        }
+
+        /* The least recently used entries go out */
+        while( cached.size + entrySize > cached.maxSize && !cached.order.empty() )
+        {
+            remove( cached, cached.entries.find( cached.order.back() ));
+        }
+
+        cached.order.push_front( aRequest );
+        auto& item = cached.entries[ aRequest ];
+        item.answer.assign( aAnswer, aAnswerSize );
+        item.expire = now() + ( long long ) cached.ttlMcs;
+        item.order = cached.order.begin();
+        cached.size += entrySize;
+    }
+
+    return this;
+}
+
+
+
+/*
+    Remove all entries
+*/
+RpcClientCache* RpcClientCache::clear()
+{
+    lock_guard <mutex> lock( sync );
+    for( auto& method : methods )
+    {
+        method.second.entries.clear();
+        method.second.order.clear();
+        method.second.size = 0;
+    }
+    return this;
+}
+
+
+
+/*
+    Return count of hits of the method
+*/
+unsigned long long RpcClientCache::getHitCount
+(
+    string aMethod  /* Method */
+)
+{
+    lock_guard <mutex> lock( sync );
+    auto method = methods.find( aMethod );
+    return method == methods.end() ? 0 : method -> second.hitCount;
+}
+
+
+
+/*
+    Return count of misses of the method
+*/
+unsigned long long RpcClientCache::getMissCount
+(
+    string aMethod  /* Method */
+)
+{
+    lock_guard <mutex> lock( sync );
+    auto method = methods.find( aMethod );
+    return method == methods.end() ? 0 : method -> second.missCount;
+}
+
+
+
+/*
+    Return ratio of hits to calls of the method from 0 to 1
+*/
+double RpcClientCache::getHitRatio
+(
+    string aMethod  /* Method */
+)
+{
+    auto hits = getHitCount( aMethod );
+    auto calls = hits + getMissCount( aMethod );
+    return calls == 0 ? 0.0 : ( double ) hits / calls;
+}
+
+
+
+/*
+    Return ratio of hits to calls of all methods from 0 to 1
+*/
+double RpcClientCache::getHitRatio()
+{
+    lock_guard <mutex> lock( sync );
+
+    unsigned long long hits = 0;
+    unsigned long long calls = 0;
+    for( auto& method : methods )
+    {
+        hits += method.second.hitCount;
+        calls += method.second.hitCount + method.second.missCount;
+    }
+    return calls == 0 ? 0.0 : ( double ) hits / calls;
+}
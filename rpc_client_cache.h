@@ -0,0 +1,186 @@
+#pragma once
+
+
+/*
+    Cache of RPC client results
+    Cache is created at main application and may be shared by many
+    RpcClient objects of many threads. Methods are cached only after
+    setMethod with TTL and limit of bytes. RpcClient::call(string)
+    answers repeated calls with the same serialized request to the same
+    server from the cache without network. Request key of the client
+    starts with ip:port of the server. Only answers with code ok are
+    stored.
+*/
+
+
+
+#include <string>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+
+
+using namespace std;
+
+
+
+#define RPC_CLIENT_CACHE_SIZE 16777216  /* Bytes of one method, 16 MB */
+
+
+
+/*
+    Entry of the cache
+*/
+struct RpcClientCacheEntry
+{
+    string                      answer  = "";   /* Serialized answer */
+    long long                   expire  = 0;    /* Moment of the end of life */
+    list <string>::iterator     order;          /* Position in LRU list */
+};
+
+
+
+/*
+    Cached method
+*/
+struct RpcClientCacheMethod
+{
+    unsigned long long                          ttlMcs      = 0;
+    size_t                                      maxSize     = RPC_CLIENT_CACHE_SIZE;
+    size_t                                      size        = 0;    /* Bytes of requests and answers */
+    unsigned long long                          hitCount    = 0;
+    unsigned long long                          missCount   = 0;
+    unordered_map <string, RpcClientCacheEntry> entries;            /* By request key */
+    list <string>                               order;              /* From the last used */
+};
+
+
+
+class RpcClientCache
+{
+    private:
+
+        /* Main mutex for synchronizing threads */
+        mutex sync;
+
+        /* Cached methods by name */
+        unordered_map <string, RpcClientCacheMethod> methods;
+
+        /*
+            Remove entry of the method
+            Unsafe! Call under sync only.
+        */
+        void remove
+        (
+            RpcClientCacheMethod&,
+            unordered_map <string, RpcClientCacheEntry>::iterator
+        );
+
+    public:
+
+        /*
+            Create cache
+        */
+        static RpcClientCache* create();
+
+
+
+        /*
+            Destroy cache
+        */
+        void destroy();
+
+
+
+        /*
+            Set cache of the method
+            TTL 0 turns cache of the method off
+        */
+        RpcClientCache* setMethod
+        (
+            string,                             /* Method */
+            unsigned long long,                 /* TTL mcs */
+            size_t = RPC_CLIENT_CACHE_SIZE      /* Limit of bytes */
+        );
+
+
+
+        /*
+            Return true if the method is cached
+        */
+        bool isCached
+        (
+            string  /* Method */
+        );
+
+
+
+        /*
+            Return serialized answer for request key
+            Return false and count miss when the answer is not found
+        */
+        bool get
+        (
+            string,         /* Method */
+            const string&,  /* Request key */
+            string&         /* Answer */
+        );
+
+
+
+        /*
+            Put serialized answer for request key
+        */
+        RpcClientCache* put
+        (
+            string,         /* Method */
+            const string&,  /* Request key */
+            const char*,    /* Answer */
+            size_t          /* Size of answer */
+        );
+
+
+
+        /*
+            Remove all entries
+        */
+        RpcClientCache* clear();
+
+
+
+        /*
+            Return count of hits of the method
+        */
+        unsigned long long getHitCount
+        (
+            string  /* Method */
+        );
+
+
+
+        /*
+            Return count of misses of the method
+        */
+        unsigned long long getMissCount
+        (
+            string  /* Method */
+        );
+
+
+
+        /*
+            Return ratio of hits to calls of the method from 0 to 1
+        */
+        double getHitRatio
+        (
+            string  /* Method */
+        );
+
+
+
+        /*
+            Return ratio of hits to calls of all methods from 0 to 1
+        */
+        double getHitRatio();
+};
@@ -0,0 +1,123 @@
+#include "rpc_client_coalescer.h"
+
+
+
+using namespace std;
+
+
+
+/*
+    Create coalescer
+*/
+RpcClientCoalescer* RpcClientCoalescer::create()
+{
+    return new RpcClientCoalescer();
+}
+
+
+
+/*
+    Destroy coalescer
+*/
+void RpcClientCoalescer::destroy()
+{
+    delete this;
+}
+
+
+
+/*
+    Run the leader or wait for the flight of the same request
+*/
+bool RpcClientCoalescer::run
+(
+    const string&   aRequest,   /* Request key */
+    Leader          aLeader,    /* Call of the leader */
+    string&         aCode,      /* Result code */
+    string&         aAnswer     /* Serialized answer */
+)
+{
+    unique_lock <mutex> lock( sync );
+
+    auto item = flights.find( aRequest );
+    if( item != flights.end() )
+    {
+        /* Follower waits for the leader */
+        auto flight = item -> second;
+        followerCount++;
+        landed.wait( lock, [ &flight ]{ return flight -> done; });
+        aCode = flight -> code;
+        aAnswer = flight -> answer;
+        return true;
+    }
+
+    auto flight = make_shared <RpcClientFlight>();
+    flights[ aRequest ] = flight;
+    leaderCount++;
+    lock.unlock();
+
+    /* Followers get the error code when the leader throws */
+    flight -> code = "RpcClientCoalescerLeaderFailed";
+
+    /* Flight lands on any exit of the leader */
+    struct Landing
+    {
+        RpcClientCoalescer*             coalescer;
+        const string&                   request;
+        shared_ptr <RpcClientFlight>&   flight;
+
+        ~Landing()
+        {
+            coalescer -> land( request, flight );
+        }
+    } landing { this, aRequest, flight };
+
+    /* Leader calls the server without lock */
+    aLeader( aCode, aAnswer );
+
+    flight -> code = aCode;
+    flight -> answer = aAnswer;
+
+    return false;
+}
+
+
+
+/*
+    Complete the flight and wake followers up
+*/
+RpcClientCoalescer* RpcClientCoalescer::land
+(
+    const string&                   aRequest,   /* Request key */
+    shared_ptr <RpcClientFlight>&   aFlight     /* Flight */
+)
+{
+    unique_lock <mutex> lock( sync );
+    aFlight -> done = true;
+    flights.erase( aRequest );
+    lock.unlock();
+    landed.notify_all();
+    return this;
+}
+
+
+
+/*
+    Return count of calls sent to the server
+*/
+unsigned long long RpcClientCoalescer::getLeaderCount()
+{
+    lock_guard <mutex> lock( sync );
+    return leaderCount;
+}
+
+
+
+/*
+    Return count of calls answered by the flight of other call
+*/
+unsigned long long RpcClientCoalescer::getFollowerCount()
+{
+    lock_guard <mutex> lock( sync );
+    return followerCount;
+}
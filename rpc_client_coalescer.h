@@ -0,0 +1,119 @@
+#pragma once
+
+
+/*
+    Coalescer of identical concurrent RPC client calls
+    Coalescer is created at main application and shared by RpcClient
+    objects of many threads. The first call of the request key goes to
+    the server, the same calls of other threads wait for it and receive
+    its result code and serialized answer. RpcClient keys calls by
+    ip:port of the server and the serialized request. The flight ends
+    with the answer, so the next call goes to the server again. When
+    the leader throws, followers get RpcClientCoalescerLeaderFailed.
+*/
+
+
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <unordered_map>
+
+
+
+using namespace std;
+
+
+
+/*
+    Call in flight
+*/
+struct RpcClientFlight
+{
+    bool    done    = false;
+    string  code    = "";   /* Result code of the leader */
+    string  answer  = "";   /* Serialized answer */
+};
+
+
+
+class RpcClientCoalescer
+{
+    public:
+
+        /*
+            Call of the leader
+            Function sets the result code and the serialized answer
+        */
+        typedef std::function< void ( string&, string& )> Leader;
+
+    private:
+
+        /* Main mutex for synchronizing threads */
+        mutex sync;
+
+        /* Followers wait for the end of flights */
+        condition_variable landed;
+
+        /* Flights by request key */
+        unordered_map <string, shared_ptr <RpcClientFlight>> flights;
+
+        /* Statistics */
+        unsigned long long leaderCount      = 0;
+        unsigned long long followerCount    = 0;
+
+
+
+        /*
+            Complete the flight and wake followers up
+        */
+        RpcClientCoalescer* land
+        (
+            const string&,                  /* Request key */
+            shared_ptr <RpcClientFlight>&   /* Flight */
+        );
+
+    public:
+
+        /*
+            Create coalescer
+        */
+        static RpcClientCoalescer* create();
+
+
+
+        /*
+            Destroy coalescer
+        */
+        void destroy();
+
+
+
+        /*
+            Run the leader or wait for the flight of the same request
+            Return true when the result is shared by other thread
+        */
+        bool run
+        (
+            const string&,  /* Request key */
+            Leader,         /* Call of the leader */
+            string&,        /* Result code */
+            string&         /* Serialized answer */
+        );
+
+
+
+        /*
+            Return count of calls sent to the server
+        */
+        unsigned long long getLeaderCount();
+
+
+
+        /*
+            Return count of calls answered by the flight of other call
+        */
+        unsigned long long getFollowerCount();
+};
@@ -0,0 +1,271 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
+
+#include "rpc_client_loop.h"
+#include "../core/utils.h"
+
+
+
+using namespace std;
+
+
+
+/*
+    Constructor
+*/
+RpcClientLoop::RpcClientLoop()
+{
+    emptyAnswer = ParamList::create();
+    if( pipe( wake ) == 0 )
+    {
+        fcntl( wake[ 0 ], F_SETFL, O_NONBLOCK );
+        fcntl( wake[ 1 ], F_SETFL, O_NONBLOCK );
+    }
+}
+
+
+
+/*
+    Destructor
+*/
+RpcClientLoop::~RpcClientLoop()
+{
+    stop();
+    close( wake[ 0 ] );
+    close( wake[ 1 ] );
+    emptyAnswer -> destroy();
+}
+
+
+
+/*
+    Create loop
+*/
+RpcClientLoop* RpcClientLoop::create()
+{
+    return new RpcClientLoop();
+}
+
+
+
+/*
+    Destroy loop
+*/
+void RpcClientLoop::destroy()
+{
+    delete this;
+}
+
+
+
+/*
+    Start loop thread
+*/
+RpcClientLoop* RpcClientLoop::start()
+{
+    if( !running )
+    {
+        running = true;
+        loopThread = new thread( [ this ]{ loop(); } );
+    }
+    return this;
+}
+
+
+
+/*
+    Stop loop thread
+*/
+RpcClientLoop* RpcClientLoop::stop()
+{
+    if( running )
+    {
+        running = false;
+        auto sended = ::write( wake[ 1 ], "s", 1 );
+        ( void ) sended;
+        loopThread -> join();
+        delete loopThread;
+        loopThread = NULL;
+    }
+
+    /* Requests which were not posted */
+    sync.lock();
+    auto rest = tasks;
+    tasks.clear();
+    sync.unlock();
+
+    for( auto& task : rest )
+    {
+        task.request -> destroy();
+        task.onAnswer( emptyAnswer -> clear(), "RpcClientLoopStopped" );
+    }
+
+    return this;
+}
+
+
+
+/*
+    Push request to the loop
+*/
+RpcClientLoop* RpcClientLoop::push
+(
+    RpcClient*          aClient,    /* Client */
+    ParamList*          aRequest,   /* Request */
+    RpcClient::OnAnswer aOnAnswer,  /* Answer callback */
+    unsigned int        aMethodId   /* Method id */
+)
+{
+    sync.lock();
+    tasks.push_back( Task{ aClient, aRequest, aOnAnswer, aMethodId });
+    sync.unlock();
+
+    /* Wake the loop up */
+    auto sended = ::write( wake[ 1 ], "t", 1 );
+    ( void ) sended;
+
+    return this;
+}
+
+
+
+/*
+    Loop body
+*/
+void RpcClientLoop::loop()
+{
+    vector <Task> batch;
+
+    while( running )
+    {
+        /* Post new requests on client connections */
+        sync.lock();
+        batch.swap( tasks );
+        sync.unlock();
+
+        for( auto& task : batch )
+        {
+            auto client = task.client;
+            auto id = client -> post( task.request, task.onAnswer, task.methodId );
+            task.request -> destroy();
+
+            if( id == 0 )
+            {
+                auto code = client -> getCode();
+                task.onAnswer( emptyAnswer -> clear(), code );
+                fail( client, code );
+            }
+            else if( active.find( client ) == active.end() )
+            {
+                active[ client ] = now();
+            }
+        }
+        batch.clear();
+
+        /* Wait for answers and new tasks */
+        fd_set readset;
+        FD_ZERO( &readset );
+        FD_SET( wake[ 0 ], &readset );
+        int maxHandle = wake[ 0 ];
+
+        for( auto& item : active )
+        {
+            auto handle = item.first -> getHandle();
+            FD_SET( handle, &readset );
+            maxHandle = max( maxHandle, handle );
+        }
+
+        timeval timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_usec = 100000;
+
+        auto selectResult = select( maxHandle + 1, &readset, NULL, NULL, &timeout );
+
+        if( selectResult > 0 && FD_ISSET( wake[ 0 ], &readset ))
+        {
+            char signals[ 64 ];
+            while( read( wake[ 0 ], signals, sizeof( signals )) > 0 );
+        }
+
+        /* Read answers */
+        auto moment = now();
+        for( auto item = active.begin(); item != active.end(); )
+        {
+            auto client = item -> first;
+
+            if( selectResult > 0 && FD_ISSET( client -> getHandle(), &readset ))
+            {
+                /* Partial answer waits for the next select */
+                client -> clientReadReady();
+                item -> second = moment;
+            }
+
+            if( !client -> isOk() )
+            {
+                fail( client, client -> getCode() );
+            }
+            else if(( unsigned long long )( moment - item -> second ) > timeoutMcs )
+            {
+                fail( client, "RpcCallTimeout" );
+            }
+
+            if( client -> getPendingCount() == 0 )
+            {
+                item = active.erase( item );
+            }
+            else
+            {
+                item++;
+            }
+        }
+    }
+
+    /* Requests in flight */
+    for( auto& item : active )
+    {
+        fail( item.first, "RpcClientLoopStopped" );
+    }
+    active.clear();
+}
+
+
+
+/*
+    Fail requests in flight of the client
+*/
+RpcClientLoop* RpcClientLoop::fail
+(
+    RpcClient*  aClient,
+    string      aCode
+)
+{
+    aClient -> cancel( aCode );
+    /* Client will connect again for the next request */
+    aClient -> setCode( "ok" );
+    return this;
+}
+
+
+
+/*
+    Set timeout of waiting for answers
+*/
+RpcClientLoop* RpcClientLoop::setTimeoutMcs
+(
+    unsigned long long a
+)
+{
+    timeoutMcs = a;
+    return this;
+}
+
+
+
+/*
+    Return timeout of waiting for answers
+*/
+unsigned long long RpcClientLoop::getTimeoutMcs()
+{
+    return timeoutMcs;
+}
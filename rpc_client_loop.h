@@ -0,0 +1,156 @@
+#pragma once
+
+
+/*
+    Event loop for asynchronous RPC clients
+    One loop thread drives many RpcClient objects. Application threads
+    push requests with RpcClient::callAsync and get answers in callbacks
+    on the loop thread. Requests are posted on the client connections
+    and answers of all connections are waited by one select, so hundreds
+    of calls may be in flight without a thread per call.
+    Client attached to the loop must not be used for synchronous calls.
+*/
+
+
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <map>
+
+#include "rpc_client.h"
+
+
+
+#define RPC_CLIENT_LOOP_TIMEOUT_MCS 1000000
+
+
+
+class RpcClientLoop
+{
+    private:
+
+        /*
+            Request waiting for the loop
+        */
+        struct Task
+        {
+            RpcClient*          client      = NULL;
+            ParamList*          request     = NULL;     /* Owned by loop */
+            RpcClient::OnAnswer onAnswer    = NULL;
+            unsigned int        methodId    = 0;
+        };
+
+        /* Main mutex for synchronizing tasks */
+        mutex                   sync;
+        vector <Task>           tasks;
+
+        /* Loop thread */
+        thread*                 loopThread  = NULL;
+        atomic <bool>           running     { false };
+
+        /* Pipe for waking the loop up on new tasks */
+        int                     wake[ 2 ]   = { -1, -1 };
+
+        /* Clients with requests in flight and moment of last answer */
+        map <RpcClient*, long long> active;
+
+        /* Empty answer for failed requests */
+        ParamList*              emptyAnswer = NULL;
+
+        /* Timeout of waiting for answers */
+        unsigned long long      timeoutMcs  = RPC_CLIENT_LOOP_TIMEOUT_MCS;
+
+        /*
+            Loop body
+        */
+        void loop();
+
+
+
+        /*
+            Fail requests in flight of the client and make it ready
+            for the next connection
+        */
+        RpcClientLoop* fail
+        (
+            RpcClient*,
+            string  /* Code */
+        );
+
+    public:
+
+        /*
+            Constructor
+        */
+        RpcClientLoop();
+
+
+
+        /*
+            Destructor
+        */
+        ~RpcClientLoop();
+
+
+
+        /*
+            Create loop
+        */
+        static RpcClientLoop* create();
+
+
+
+        /*
+            Destroy loop
+        */
+        void destroy();
+
+
+
+        /*
+            Start loop thread
+        */
+        RpcClientLoop* start();
+
+
+
+        /*
+            Stop loop thread
+            Requests in flight are failed with RpcClientLoopStopped
+        */
+        RpcClientLoop* stop();
+
+
+
+        /*
+            Push request to the loop
+            Thread safe. Request is owned by loop and destroyed after
+            writing. Callback is called on the loop thread.
+        */
+        RpcClientLoop* push
+        (
+            RpcClient*,             /* Client */
+            ParamList*,             /* Request */
+            RpcClient::OnAnswer,    /* Answer callback */
+            unsigned int = 0        /* Method id */
+        );
+
+
+
+        /*
+            Set timeout of waiting for answers
+        */
+        RpcClientLoop* setTimeoutMcs
+        (
+            unsigned long long
+        );
+
+
+
+        /*
+            Return timeout of waiting for answers
+        */
+        unsigned long long getTimeoutMcs();
+};
@@ -0,0 +1,313 @@
+#pragma once
+
+
+/*
+    C++20 coroutines for RPC
+    Server handler may be written as coroutine and may await calls of
+    other servers without blocking the listen loop:
+
+        server -> setOnCallDeferred
+        (
+            rpcCoroutine
+            (
+                server,
+                []( ParamList* aArguments, ParamList* aAnswer ) -> RpcTask
+                {
+                    auto code = co_await rpcCall( client, request, aAnswer );
+                    ...
+                }
+            )
+        );
+
+    Clients must be attached to RpcClientLoop, it drives the downstream
+    calls. Answer of the call is scheduled to the listen loop of the
+    server, so the handler starts and resumes on the listen loop only
+    and the answer is written there.
+    Header is empty for the language standards before C++20, so the
+    library objects are the same for any standard.
+*/
+
+
+
+#if __cplusplus >= 202002L && __has_include( <coroutine> )
+
+#include <coroutine>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <functional>
+
+#include "rpc_client.h"
+#include "rpc_server.h"
+
+
+
+/*
+    Coroutine of RPC handler
+    Coroutine starts at once and destroys own frame at the end
+*/
+class RpcTask
+{
+    public:
+
+        /*
+            State shared between task and coroutine
+        */
+        struct State
+        {
+            mutex                       sync;
+            bool                        done    = false;
+            std::function< void () >    onDone  = NULL;
+            RpcServer*                  server  = NULL; /* Listen loop for resume or NULL */
+
+            /*
+                Mark coroutine as done and call done callback
+            */
+            void finish()
+            {
+                sync.lock();
+                done = true;
+                auto callback = onDone;
+                onDone = NULL;
+                sync.unlock();
+
+                if( callback )
+                {
+                    callback();
+                }
+            }
+        };
+
+
+
+        /*
+            Promise of coroutine
+        */
+        struct promise_type
+        {
+            shared_ptr <State> state = make_shared <State> ();
+
+            RpcTask get_return_object()
+            {
+                state -> server = starter;
+                return RpcTask( state );
+            }
+
+            std::suspend_never initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            std::suspend_never final_suspend() noexcept
+            {
+                return {};
+            }
+
+            void return_void()
+            {
+                state -> finish();
+            }
+
+            void unhandled_exception()
+            {
+                state -> finish();
+            }
+        };
+
+    private:
+
+        shared_ptr <State> state;
+
+    public:
+
+        /* Server of the coroutine being started on the thread */
+        static inline thread_local RpcServer* starter = NULL;
+
+        /*
+            Constructor
+        */
+        RpcTask
+        (
+            shared_ptr <State> aState
+        )
+        {
+            state = aState;
+        }
+
+
+
+        /*
+            Set callback for the end of coroutine
+            Callback is called at once if coroutine is done
+        */
+        RpcTask& then
+        (
+            std::function< void () > aOnDone
+        )
+        {
+            state -> sync.lock();
+            auto done = state -> done;
+            if( !done )
+            {
+                state -> onDone = aOnDone;
+            }
+            state -> sync.unlock();
+
+            if( done )
+            {
+                aOnDone();
+            }
+            return *this;
+        }
+
+
+
+        /*
+            Return true if coroutine is done
+        */
+        bool isDone()
+        {
+            lock_guard <mutex> lock( state -> sync );
+            return state -> done;
+        }
+};
+
+
+
+/*
+    Awaiter of RpcClient call
+    Result of co_await is the result code of the call
+*/
+class RpcCallAwaiter
+{
+    private:
+
+        RpcClient*          client      = NULL;
+        ParamList*          request     = NULL;     /* Owned by loop */
+        ParamList*          answer      = NULL;
+        unsigned int        methodId    = 0;
+        string              code        = "";
+
+        /* Answer came before coroutine suspension */
+        atomic <bool>       ready       { false };
+
+    public:
+
+        /*
+            Constructor
+        */
+        RpcCallAwaiter
+        (
+            RpcClient*      aClient,    /* Client attached to loop */
+            ParamList*      aRequest,   /* Request, owned by loop */
+            ParamList*      aAnswer,    /* Answer */
+            unsigned int    aMethodId   /* Method id */
+        )
+        {
+            client      = aClient;
+            request     = aRequest;
+            answer      = aAnswer;
+            methodId    = aMethodId;
+        }
+
+
+
+        bool await_ready()
+        {
+            return false;
+        }
+
+
+
+        bool await_suspend
+        (
+            std::coroutine_handle< RpcTask::promise_type > aHandle
+        )
+        {
+            client -> callAsync
+            (
+                request,
+                [ this, aHandle ]( ParamList* aResult, string aCode )
+                {
+                    /* Copy answer through its buffer */
+                    void* buffer = NULL;
+                    size_t bufferSize = 0;
+                    aResult -> toBuffer( buffer, bufferSize );
+                    answer -> clear() -> fromBuffer( buffer, bufferSize );
+                    ::operator delete( buffer );
+
+                    code = aCode;
+
+                    /* Resume coroutine if it is suspended already */
+                    if( ready.exchange( true ))
+                    {
+                        auto server = aHandle.promise().state -> server;
+                        if( server == NULL )
+                        {
+                            aHandle.resume();
+                        }
+                        else
+                        {
+                            server -> schedule( [ aHandle ]{ aHandle.resume(); } );
+                        }
+                    }
+                },
+                methodId
+            );
+
+            /* Do not suspend if answer came at once */
+            return !ready.exchange( true );
+        }
+
+
+
+        string await_resume()
+        {
+            return code;
+        }
+};
+
+
+
+/*
+    Return awaiter of RpcClient call
+*/
+inline RpcCallAwaiter rpcCall
+(
+    RpcClient*      aClient,        /* Client attached to loop */
+    ParamList*      aRequest,       /* Request, owned by loop */
+    ParamList*      aAnswer,        /* Answer */
+    unsigned int    aMethodId = 0   /* Method id */
+)
+{
+    return RpcCallAwaiter( aClient, aRequest, aAnswer, aMethodId );
+}
+
+
+
+/*
+    Return deferred server handler for coroutine handler
+    Coroutine resumes on the listen loop of the server
+*/
+inline RpcServer::OnCallDeferred rpcCoroutine
+(
+    RpcServer*                                              aServer,    /* Server */
+    std::function< RpcTask ( ParamList*, ParamList* ) >     aHandler    /* Handler */
+)
+{
+    return
+    [ aServer, aHandler ]
+    (
+        ParamList* aArguments,
+        ParamList* aAnswer,
+        std::function< void () > aDone
+    )
+    {
+        RpcTask::starter = aServer;
+        auto task = aHandler( aArguments, aAnswer );
+        RpcTask::starter = NULL;
+        task.then( aDone );
+    };
+}
+
+#endif
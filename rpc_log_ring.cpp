@@ -0,0 +1,281 @@
+#include <cstdint>
+#include <unistd.h>
+
+#include "rpc_log_ring.h"
+#include "../core/utils.h"
+
+
+
+using namespace std;
+
+
+
+/*
+    Constructor
+*/
+RpcLogRing::RpcLogRing
+(
+    LogManager* aLogManager,    /* Log manager */
+    size_t      aCapacity       /* Capacity, rounded up to power of two */
+)
+{
+    logManager = aLogManager;
+
+    size_t capacity = 2;
+    while( capacity < aCapacity )
+    {
+        capacity <<= 1;
+    }
+
+    cells = new Cell[ capacity ];
+    mask = capacity - 1;
+
+    for( size_t i = 0; i < capacity; i++ )
+    {
+        cells[ i ].sequence.store( i, memory_order_relaxed );
+    }
+}
+
+
+
+/*
+    Destructor
+*/
+RpcLogRing::~RpcLogRing()
+{
+    stop();
+    delete [] cells;
+}
+
+
+
+/*
+    Create ring
+*/
+RpcLogRing* RpcLogRing::create
+(
+    LogManager* aLogManager,    /* Log manager */
+    size_t      aCapacity       /* Capacity */
+)
+{
+    return new RpcLogRing( aLogManager, aCapacity );
+}
+
+
+
+/*
+    Destroy ring
+*/
+void RpcLogRing::destroy()
+{
+    delete this;
+}
+
+
+
+/*
+    Start drain thread
+*/
+RpcLogRing* RpcLogRing::start()
+{
+    if( !running )
+    {
+        running = true;
+        drain = new thread( [ this ]{ work(); } );
+    }
+    return this;
+}
+
+
+
+/*
+    Stop drain thread
+*/
+RpcLogRing* RpcLogRing::stop()
+{
+    if( running )
+    {
+        running = false;
+        drain -> join();
+        delete drain;
+        drain = NULL;
+    }
+
+    /* Records pushed after the last pass of the thread */
+    flush();
+
+    return this;
+}
+
+
+
+/*
+    Push record
+*/
+bool RpcLogRing::push
+(
+    const char* aEvent,     /* Event */
+    const char* aName,      /* Name */
+    long long   aValue,     /* Value */
+    const char* aName2,     /* Second name */
+    long long   aValue2     /* Second value */
+)
+{
+    Cell* cell = NULL;
+    auto position = pushPosition.load( memory_order_relaxed );
+
+    while( true )
+    {
+        cell = &cells[ position & mask ];
+        auto sequence = cell -> sequence.load( memory_order_acquire );
+        auto difference = ( intptr_t ) sequence - ( intptr_t ) position;
+
+        if( difference == 0 )
+        {
+            /* Cell is free, take the position */
+            if
+            (
+                pushPosition.compare_exchange_weak
+                (
+                    position,
+                    position + 1,
+                    memory_order_relaxed
+                )
+            )
+            {
+                break;
+            }
+        }
+        else if( difference < 0 )
+        {
+            /* Drain thread is late, the record is lost */
+            droppedCount.fetch_add( 1, memory_order_relaxed );
+            return false;
+        }
+        else
+        {
+            position = pushPosition.load( memory_order_relaxed );
+        }
+    }
+
+    auto& record = cell -> record;
+    record.moment = now();
+    record.event = aEvent;
+    record.name = aName;
+    record.value = aValue;
+    record.name2 = aName2;
+    record.value2 = aValue2;
+    cell -> sequence.store( position + 1, memory_order_release );
+    return true;
+}
+
+
+
+/*
+    Pop record
+*/
+bool RpcLogRing::pop
+(
+    RpcLogRecord& aRecord
+)
+{
+    Cell* cell = NULL;
+    auto position = popPosition.load( memory_order_relaxed );
+
+    while( true )
+    {
+        cell = &cells[ position & mask ];
+        auto sequence = cell -> sequence.load( memory_order_acquire );
+        auto difference = ( intptr_t ) sequence - ( intptr_t )( position + 1 );
+
+        if( difference == 0 )
+        {
+            /* Cell is pushed, take the position */
+            if
+            (
+                popPosition.compare_exchange_weak
+                (
+                    position,
+                    position + 1,
+                    memory_order_relaxed
+                )
+            )
+            {
+                break;
+            }
+        }
+        else if( difference < 0 )
+        {
+            /* Cell is not pushed yet, ring is empty */
+            return false;
+        }
+        else
+        {
+            position = popPosition.load( memory_order_relaxed );
+        }
+    }
+
+    aRecord = cell -> record;
+    cell -> sequence.store( position + mask + 1, memory_order_release );
+    return true;
+}
+
+
+
+/*
+    Write records to the log until the ring is empty
+*/
+RpcLogRing* RpcLogRing::flush()
+{
+    RpcLogRecord record;
+    while( pop( record ))
+    {
+        auto log = logManager -> getLog();
+        log -> trace( record.event ) -> prm( "moment", record.moment );
+        if( record.name != NULL )
+        {
+            log -> prm( record.name, record.value );
+        }
+        if( record.name2 != NULL )
+        {
+            log -> prm( record.name2, record.value2 );
+        }
+        log -> lineEnd();
+        writtenCount.fetch_add( 1, memory_order_relaxed );
+    }
+    return this;
+}
+
+
+
+/*
+    Drain thread body
+*/
+void RpcLogRing::work()
+{
+    while( running )
+    {
+        flush();
+        usleep( RPC_LOG_RING_SLEEP_MCS );
+    }
+}
+
+
+
+/*
+    Return count of written records
+*/
+unsigned long long RpcLogRing::getWrittenCount()
+{
+    return writtenCount.load( memory_order_relaxed );
+}
+
+
+
+/*
+    Return count of records dropped by the full ring
+*/
+unsigned long long RpcLogRing::getDroppedCount()
+{
+    return droppedCount.load( memory_order_relaxed );
+}
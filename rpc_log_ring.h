@@ -0,0 +1,180 @@
+#pragma once
+
+
+/*
+    Asynchronous log sink of the RPC layer
+    Hot path pushes fixed records without formatting to the lock free
+    ring of D. Vyukov, the drain thread formats them to the log of
+    LogManager. Event and names of records must be string literals.
+    Records are dropped and counted when the ring is full, so writers
+    never wait for the log.
+*/
+
+
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+#include "../core/log_manager.h"
+
+
+
+using namespace std;
+
+
+
+#define RPC_LOG_RING_SIZE       65536   /* Count of records */
+#define RPC_LOG_RING_SLEEP_MCS  1000    /* Sleep of the empty drain thread */
+#define RPC_LOG_RING_ALIGN      64      /* Size of cache line */
+
+
+
+/*
+    Record of the log
+*/
+struct RpcLogRecord
+{
+    long long       moment  = 0;        /* Moment of the event */
+    const char*     event   = NULL;     /* Literal */
+    const char*     name    = NULL;     /* Literal or NULL */
+    long long       value   = 0;
+    const char*     name2   = NULL;     /* Literal or NULL */
+    long long       value2  = 0;
+};
+
+
+
+class RpcLogRing
+{
+    private:
+
+        /*
+            Cell of the ring
+        */
+        struct Cell
+        {
+            atomic <size_t> sequence    { 0 };
+            RpcLogRecord    record;
+        };
+
+        LogManager*     logManager  = NULL;
+        Cell*           cells       = NULL;
+        size_t          mask        = 0;
+
+        /* Positions are on own cache lines */
+        alignas( RPC_LOG_RING_ALIGN ) atomic <size_t> pushPosition { 0 };
+        alignas( RPC_LOG_RING_ALIGN ) atomic <size_t> popPosition { 0 };
+
+        /* Drain thread */
+        thread*                         drain           = NULL;
+        atomic <bool>                   running         { false };
+
+        /* Statistics */
+        atomic <unsigned long long>     writtenCount    { 0 };
+        atomic <unsigned long long>     droppedCount    { 0 };
+
+
+
+        /*
+            Pop record
+            Return false when the ring is empty
+        */
+        bool pop
+        (
+            RpcLogRecord&
+        );
+
+
+
+        /*
+            Write records to the log until the ring is empty
+        */
+        RpcLogRing* flush();
+
+
+
+        /*
+            Drain thread body
+        */
+        void work();
+
+    public:
+
+        /*
+            Constructor
+        */
+        RpcLogRing
+        (
+            LogManager*,                    /* Log manager */
+            size_t = RPC_LOG_RING_SIZE      /* Capacity, rounded up to power of two */
+        );
+
+
+
+        /*
+            Destructor
+        */
+        ~RpcLogRing();
+
+
+
+        /*
+            Create ring
+        */
+        static RpcLogRing* create
+        (
+            LogManager*,                    /* Log manager */
+            size_t = RPC_LOG_RING_SIZE      /* Capacity */
+        );
+
+
+
+        /*
+            Destroy ring, the rest of records is written
+        */
+        void destroy();
+
+
+
+        /*
+            Start drain thread
+        */
+        RpcLogRing* start();
+
+
+
+        /*
+            Stop drain thread, the rest of records is written
+        */
+        RpcLogRing* stop();
+
+
+
+        /*
+            Push record
+            Return false when the ring is full and record is dropped
+        */
+        bool push
+        (
+            const char*,            /* Event */
+            const char* = NULL,     /* Name */
+            long long = 0,          /* Value */
+            const char* = NULL,     /* Second name */
+            long long = 0           /* Second value */
+        );
+
+
+
+        /*
+            Return count of written records
+        */
+        unsigned long long getWrittenCount();
+
+
+
+        /*
+            Return count of records dropped by the full ring
+        */
+        unsigned long long getDroppedCount();
+};
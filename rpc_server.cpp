@@ -2,8 +2,12 @@
 #include <iostream>
 #include <cstring>
 #include <sstream>
+#include <cmath>
+#include <climits>
+#include <algorithm>
 
 #include "rpc_server.h"
+#include "../core/utils.h"
 #include "../core/buffer_to_hex.h"
 
 
@@ -33,6 +37,61 @@ SockRpc
     aPort
 )
 {
+    cache = RpcServerCache::create();
+}
+
+
+
+/*
+    Return arguments, they are decoded on the first call
+*/
+ParamList* RpcServerCall::getArguments()
+{
+    if( arguments == NULL )
+    {
+        arguments = ParamList::create();
+        if( payloadSize > 0 && !typed )
+        {
+            arguments -> fromBuffer
+            (
+                ( void* )( payloadView == NULL ? payload.data() : payloadView ),
+                payloadSize
+            );
+        }
+    }
+    return arguments;
+}
+
+
+
+/*
+    Copy serialized arguments from the read buffer
+*/
+RpcServerCall& RpcServerCall::keepPayload()
+{
+    if( payloadView != NULL )
+    {
+        if( arguments == NULL && payload.empty() )
+        {
+            payload.assign( payloadView, payloadSize );
+        }
+        payloadView = NULL;
+    }
+    return *this;
+}
+
+
+
+/*
+    Destructor
+*/
+RpcServer::~RpcServer()
+{
+    cache -> destroy();
+    for( auto method : methods )
+    {
+        delete method;
+    }
 }
 
 
@@ -120,41 +179,193 @@ bool RpcServer::onReadAfter
     int aHandle             /* handle of the client socket */
 )
 {
-    getLog()
-    -> trapOn()
-    -> begin( "RPC Server onReadAfter" )
-    -> prm( "size", aBuffer -> getBufferSize() )
-    -> lineEnd();
+    /* Trap block is written to the log only without the ring */
+    bool traced = isLogLevel( RLL_TRACE ) && getLogRing() == NULL;
+    if( traced )
+    {
+        getLog()
+        -> trapOn()
+        -> begin( "RPC Server onReadAfter" )
+        -> prm( "size", aBuffer -> getBufferSize() )
+        -> lineEnd();
+    }
+    else if( isLogLevel( RLL_TRACE ))
+    {
+        trace( "RPC Server onReadAfter", "size", aBuffer -> getBufferSize() );
+    }
 
     auto result = true;
     auto header = SockRpcHeader::create( aBuffer );
-    if( header.isValid() )
-    {
+    size_t argumentsSize = 0;
+    char* argumentsBuffer =
+    header.isValid() && header.isFull( aBuffer )
+    ? getPayload( aBuffer, header, argumentsSize )
+    : NULL;
 
-        auto buffer = aBuffer -> getBuffer();
+    /* Stored answer of the same arguments */
+    bool stream = header.flags & RPC_FLAG_STREAM;
+    bool typed = header.flags & RPC_FLAG_TYPED;
+    unsigned long long cacheKey = 0;
+    bool cacheKeyReady = false;
+    RpcServerCacheEntry* entry = NULL;
 
-        /* Get method arguments */
-        auto argumentsBuffer = (void*) ( &buffer[ sizeof( SockRpcHeader ) ] );
+    /* Budget from the wire is clamped, so the sum does not overflow */
+    long long moment = now();
+    long long deadline =
+    header.deadlineMcs > 0
+    ? moment + ( long long ) min
+    (
+        header.deadlineMcs,
+        ( unsigned long long )( LLONG_MAX - moment )
+    )
+    : 0;
 
-        auto answer = ParamList::create();
-        auto arguments = ParamList::create()
-        -> fromBuffer
+    if( argumentsBuffer != NULL && !stream && !typed && cache -> getCount() > 0 )
+    {
+        cacheKeyReady = true;
+        cacheKey = RpcServerCache::calcKey
         (
+            header.methodId,
             argumentsBuffer,
-            header.argumentsSize
+            argumentsSize
+        );
+        entry = cache -> get
+        (
+            cacheKey,
+            header.methodId,
+            argumentsBuffer,
+            argumentsSize,
+            moment
+        );
+    }
+
+    if( entry != NULL && ( deadline == 0 || ( long long ) now() < deadline ))
+    {
+        /* Hit is written without decode, handler and encode */
+        entry -> method -> cacheHitCount++;
+        writePayload
+        (
+            entry -> answer.data(),
+            entry -> answer.size(),
+            aHandle,
+            getAnswerHeader( header )
         );
+    }
+    else if( argumentsBuffer != NULL )
+    {
+        RpcServerCall call;
+        call.handle         = aHandle;
+        call.serial         = getConnectionSerial( aHandle );
+        call.header         = header;
+        call.moment         = moment;
+        call.deadline       = deadline;
+        call.answer         = ParamList::create();
+        call.payloadView    = argumentsBuffer;
+        call.payloadSize    = argumentsSize;
+        call.typed          = typed;
 
-        /* Call onAfter method for server */
-        onCallAfter( arguments, answer );
-        getLog()
-        -> dump( arguments, "arguments" )
-        -> dump( answer, "result" );
+        auto method = findMethod( call );
+        call.method = method;
+
+        /* Expired hit, stream and inline calls are answered without handler */
+        bool expired = expire( call );
 
-        /* Send answer to client */
-        write( answer, aHandle );
+        if
+        (
+            !expired &&
+            method != NULL &&
+            method -> cacheTtlMcs > 0 &&
+            !stream &&
+            !typed
+        )
+        {
+            /* Answer of the miss goes to the cache */
+            method -> cacheMissCount++;
+            cache -> miss();
+            call.cacheable = true;
+            call.cacheKey =
+            cacheKeyReady
+            ? cacheKey
+            : RpcServerCache::calcKey
+            (
+                header.methodId,
+                argumentsBuffer,
+                argumentsSize
+            );
+            /* Serialized arguments are the key data of the cache entry */
+            call.payload.assign( argumentsBuffer, argumentsSize );
+            call.keepPayload();
+        }
+
+        if( expired )
+        {
+            writeAnswer( call );
+        }
+        else if( !admit( call ))
+        {
+            /* Fast answer lets client back off */
+            overload( call );
+            writeAnswer( call );
+        }
+        else if( stream )
+        {
+            /* Chunks are sent by emit, answer ends the stream */
+            streamCall = &call;
+            runCall( method, call );
+            streamCall = NULL;
+            writeAnswer( call );
+        }
+        else if( method == NULL && onCallDeferred && !typed )
+        {
+            /*
+                Answer is written by listen loop when handler is done.
+                Arguments are decoded before the capture, so the copy
+                owns them and has no view of the read buffer.
+            */
+            auto arguments = call.getArguments();
+            call.keepPayload();
+            onCallDeferred
+            (
+                arguments,
+                call.answer,
+                [ this, call ]() mutable
+                {
+                    finish( call );
+                }
+            );
+        }
+        else if( pool != NULL )
+        {
+            /* Handler runs and decodes arguments on worker */
+            call.keepPayload();
+            auto pushed = pool -> push
+            (
+                [ this, method, call ]() mutable
+                {
+                    if( shed( call ))
+                    {
+                        overload( call );
+                    }
+                    else if( !expire( call ))
+                    {
+                        runCall( method, call );
+                    }
+                    finish( call );
+                },
+                aHandle
+            );
 
-        arguments -> destroy();
-        answer -> destroy();
+            if( !pushed )
+            {
+                overload( call );
+                writeAnswer( call );
+            }
+        }
+        else
+        {
+            runCall( method, call );
+            writeAnswer( call );
+        }
     }
     else
     {
@@ -162,64 +373,967 @@ bool RpcServer::onReadAfter
         result = false;
     }
 
-    getLog()
-    -> end()
-    -> lineEnd()
-    -> trapOff();
+    if( traced )
+    {
+        getLog()
+        -> end()
+        -> lineEnd()
+        -> trapOff();
+    }
     return result;
 }
 
 
 
 /*
-    On call event
-    Method may be ovverided
+    Count the call in flight if limits allow it
 */
-bool RpcServer::onCallBefore
+bool RpcServer::admit
 (
-    string aIp /* client ip address */
+    RpcServerCall& aCall
 )
 {
-//    getLog() -> trace( "RPC" ) -> prm( "ip", aIp );
-    return true;
+    auto method = aCall.method;
+
+    bool result =
+    ( maxInFlight == 0 || inFlight < maxInFlight ) &&
+    (
+        method == NULL ||
+        method -> maxInFlight == 0 ||
+        method -> inFlight < method -> maxInFlight
+    );
+
+    if( result )
+    {
+        inFlight++;
+        if( method != NULL )
+        {
+            method -> inFlight++;
+        }
+        aCall.admitted = true;
+    }
+
+    return result;
 }
 
 
 
 /*
-    Servers On call after event
-    Method may be ovverided
+    Return true if the call waited in the queue too long
+    CoDel control law: shedding starts when the delay stays over the
+    target for the interval, the next call is shed after interval
+    divided by square root of count of shed calls
 */
-RpcServer* RpcServer::onCallAfter
+bool RpcServer::shed
 (
-    ParamList* aArguments,
-    ParamList* aResults
+    RpcServerCall& aCall
+)
+{
+    bool result = false;
+
+    if( codelTarget > 0 )
+    {
+        auto moment = now();
+        unsigned long long delay = moment - aCall.moment;
+
+        lock_guard <mutex> lock( codelSync );
+
+        bool overTarget = false;
+        if( delay < codelTarget )
+        {
+            firstAboveTime = 0;
+        }
+        else if( firstAboveTime == 0 )
+        {
+            firstAboveTime = moment + codelInterval;
+        }
+        else
+        {
+            overTarget = moment >= firstAboveTime;
+        }
+
+        if( dropping )
+        {
+            if( !overTarget )
+            {
+                dropping = false;
+            }
+            else if( moment >= dropNext )
+            {
+                result = true;
+                dropCount++;
+                dropNext += ( long long )( codelInterval / sqrt( dropCount ));
+            }
+        }
+        else if( overTarget )
+        {
+            result = true;
+            dropping = true;
 
+            /* Shedding goes on at the last rate after short pause */
+            dropCount =
+            dropCount > 2 &&
+            moment - dropNext < 8 * ( long long ) codelInterval
+            ? dropCount - 2
+            : 1;
+            dropNext = moment + ( long long )( codelInterval / sqrt( dropCount ));
+        }
+    }
+
+    return result;
+}
+
+
+
+/*
+    Answer the call with overloaded code
+*/
+RpcServer* RpcServer::overload
+(
+    RpcServerCall& aCall
 )
 {
-//    getLog() -> trace( "onCallAfter" );
-    aResults -> setString( "Answer", "Hello world!" );
+    overloadedCount++;
+    if( aCall.method != NULL )
+    {
+        aCall.method -> rejectCount++;
+    }
+    aCall.answer -> setString( Path{ "result", "code" }, RPC_OVERLOADED );
     return this;
 }
 
 
 
+/*
+    Answer the call with deadline exceeded code
+*/
+bool RpcServer::expire
+(
+    RpcServerCall& aCall
+)
+{
+    bool result = aCall.deadline > 0 && ( long long ) now() >= aCall.deadline;
+    if( result )
+    {
+        expiredCount++;
+        if( aCall.method != NULL )
+        {
+            aCall.method -> expiredCount++;
+        }
+        aCall.answer -> setString
+        (
+            Path{ "result", "code" },
+            RPC_DEADLINE_EXCEEDED
+        );
+    }
+    return result;
+}
+
+
 
 /*
-    Servers On error event
+    Call registered method, onCallStreamAfter for streams or onCall
 */
-bool RpcServer::onError
+RpcServer* RpcServer::runCall
 (
-    Result* aResult
+    RpcMethod*      aMethod,    /* Method or NULL */
+    RpcServerCall&  aCall
 )
 {
-    getLog()
-    -> warning( "Server error" )
-    -> prm( "code", aResult -> getCode() )
-    -> prm( "message", aResult -> getMessage() )
-    -> dump( aResult -> getDetails() )
-    ;
+    /* Handler and its nested client calls see the budget */
+    setCallDeadline( aCall.deadline );
+    bool stream = aCall.header.flags & RPC_FLAG_STREAM;
+    if( aCall.typed && stream )
+    {
+        /* Chunks of emit are ParamList */
+        aCall.answer -> setString
+        (
+            Path{ "result", "code" },
+            "typed_call_is_not_streamed"
+        );
+    }
+    else if( aCall.typed && ( aMethod == NULL || aMethod -> typedHandler == NULL ))
+    {
+        /* Typed payload is not ParamList for onCallAfter */
+        aCall.answer -> setString
+        (
+            Path{ "result", "code" },
+            "typed_method_not_found"
+        );
+    }
+    else if( aMethod != NULL )
+    {
+        callMethod( aMethod, aCall );
+    }
+    else if( stream )
+    {
+        onCallStreamAfter( aCall.getArguments(), aCall.answer );
+    }
+    else
+    {
+        /* Call handler of the server */
+        onCall( aCall );
+    }
+    setCallDeadline( 0 );
+    return this;
+}
 
-    return true;
+
+
+/*
+    Queue finished call for writing by the listen loop
+*/
+RpcServer* RpcServer::finish
+(
+    RpcServerCall& aCall
+)
+{
+    finishedSync.lock();
+    finished.push_back( aCall );
+    finishedSync.unlock();
+    wakeUp();
+    return this;
+}
+
+
+
+/*
+    Return header of the answer for the request
+    Answer has version and ids of the request
+*/
+SockRpcHeader RpcServer::getAnswerHeader
+(
+    SockRpcHeader& aRequest     /* Request header */
+)
+{
+    auto result = SockRpcHeader::create( 0, aRequest.version );
+    result.requestId    = aRequest.requestId;
+    result.methodId     = aRequest.methodId;
+    if( aRequest.flags & RPC_FLAG_ACCEPT_COMPRESSED )
+    {
+        result.flags |= RPC_FLAG_COMPRESSED;
+    }
+    if( aRequest.flags & RPC_FLAG_STREAM )
+    {
+        result.flags |= RPC_FLAG_STREAM | RPC_FLAG_STREAM_END;
+    }
+    return result;
+}
+
+
+
+/*
+    Write answer of the call to the client
+*/
+RpcServer* RpcServer::writeAnswer
+(
+    RpcServerCall& aCall
+)
+{
+    /* Dumps are too heavy for the ring */
+    if( isLogLevel( RLL_DUMP ) && getLogRing() == NULL )
+    {
+        if( aCall.arguments != NULL )
+        {
+            getLog() -> dump( aCall.arguments, "arguments" );
+        }
+        getLog() -> dump( aCall.answer, "result" );
+    }
+
+    /* Call is not in flight anymore */
+    if( aCall.admitted )
+    {
+        inFlight--;
+        if( aCall.method != NULL )
+        {
+            aCall.method -> inFlight--;
+        }
+        aCall.admitted = false;
+    }
+
+    /* Client may be gone while the call was in work */
+    bool connected = aCall.serial == getConnectionSerial( aCall.handle );
+    bool ok = aCall.answer -> getString( Path{ "result", "code" }) == "ok";
+
+    if( aCall.typed && ok )
+    {
+        /* Typed answer goes without ParamList */
+        if( connected )
+        {
+            auto header = getAnswerHeader( aCall.header );
+            header.flags |= RPC_FLAG_TYPED;
+            writePayload
+            (
+                aCall.typedAnswer.data(),
+                aCall.typedAnswer.size(),
+                aCall.handle,
+                header
+            );
+        }
+    }
+    else if( aCall.cacheable && ok )
+    {
+        /* Serialized answer goes to the cache and to the client */
+        void* buffer = NULL;
+        size_t bufferSize = 0;
+        aCall.answer -> toBuffer( buffer, bufferSize );
+
+        auto method = aCall.method;
+        if
+        (
+            method -> cacheMaxAnswerSize == 0 ||
+            bufferSize <= method -> cacheMaxAnswerSize
+        )
+        {
+            cache -> put
+            (
+                aCall.cacheKey,
+                aCall.header.methodId,
+                method,
+                aCall.payload,
+                ( const char* ) buffer,
+                bufferSize,
+                now() + ( long long ) method -> cacheTtlMcs
+            );
+        }
+
+        if( connected )
+        {
+            writePayload
+            (
+                buffer,
+                bufferSize,
+                aCall.handle,
+                getAnswerHeader( aCall.header )
+            );
+        }
+
+        ::operator delete( buffer );
+    }
+    else if( connected )
+    {
+        /* Send answer to client with version and ids of request */
+        write( aCall.answer, aCall.handle, getAnswerHeader( aCall.header ));
+    }
+
+    if( aCall.arguments != NULL )
+    {
+        aCall.arguments -> destroy();
+    }
+    aCall.answer -> destroy();
+
+    return this;
+}
+
+
+
+/*
+    Write answers of finished calls
+*/
+RpcServer* RpcServer::onListenLoop()
+{
+    /* Work of other threads may finish calls */
+    scheduledSync.lock();
+    auto works = move( scheduled );
+    scheduled.clear();
+    scheduledSync.unlock();
+
+    for( auto& work : works )
+    {
+        work();
+    }
+
+    finishedSync.lock();
+    auto calls = finished;
+    finished.clear();
+    finishedSync.unlock();
+
+    for( auto& call : calls )
+    {
+        writeAnswer( call );
+    }
+
+    return this;
+}
+
+
+
+/*
+    Run function on the listen loop
+*/
+RpcServer* RpcServer::schedule
+(
+    std::function< void () > aWork
+)
+{
+    scheduledSync.lock();
+    scheduled.push_back( aWork );
+    scheduledSync.unlock();
+    wakeUp();
+    return this;
+}
+
+
+
+/*
+    Server on call event
+*/
+RpcServer* RpcServer::onCall
+(
+    RpcServerCall& aCall    /* Call */
+)
+{
+    onCallAfter( aCall.getArguments(), aCall.answer );
+    return this;
+}
+
+
+
+/*
+    Server on streamed call event
+*/
+RpcServer* RpcServer::onCallStreamAfter
+(
+    ParamList* aArguments,  /* Arguments */
+    ParamList* aAnswer      /* Answer */
+)
+{
+    onCallAfter( aArguments, aAnswer );
+    return this;
+}
+
+
+
+/*
+    Send chunk of the streamed answer to the client at once
+*/
+RpcServer* RpcServer::emit
+(
+    ParamList* aChunk   /* Chunk */
+)
+{
+    if( streamCall == NULL )
+    {
+        getLog() -> warning( "Emit out of streamed call" ) -> lineEnd();
+    }
+    else
+    {
+        auto& requestHeader = streamCall -> header;
+        auto chunkHeader = SockRpcHeader::create( 0, requestHeader.version );
+        chunkHeader.requestId   = requestHeader.requestId;
+        chunkHeader.methodId    = requestHeader.methodId;
+        chunkHeader.flags       = RPC_FLAG_STREAM;
+        if( requestHeader.flags & RPC_FLAG_ACCEPT_COMPRESSED )
+        {
+            chunkHeader.flags |= RPC_FLAG_COMPRESSED;
+        }
+        write( aChunk, streamCall -> handle, chunkHeader );
+
+        /* Chunk does not wait for the end of the read cycle */
+        flushGathered();
+    }
+    return this;
 }
 
+
+
+/*
+    Set deferred handler instead of onCallAfter
+*/
+RpcServer* RpcServer::setOnCallDeferred
+(
+    OnCallDeferred a
+)
+{
+    onCallDeferred = a;
+    return this;
+}
+
+
+
+/*
+    Set pool of workers for handlers
+*/
+RpcServer* RpcServer::setPool
+(
+    RpcServerPool* a
+)
+{
+    pool = a;
+    return this;
+}
+
+
+
+/*
+    Return pool of workers or NULL
+*/
+RpcServerPool* RpcServer::getPool()
+{
+    return pool;
+}
+
+
+
+/*
+    Set limit of calls at the same time for all methods
+*/
+RpcServer* RpcServer::setMaxInFlight
+(
+    unsigned int a
+)
+{
+    maxInFlight = a;
+    return this;
+}
+
+
+
+/*
+    Return limit of calls at the same time
+*/
+unsigned int RpcServer::getMaxInFlight()
+{
+    return maxInFlight;
+}
+
+
+
+/*
+    Return count of calls at the same time
+*/
+unsigned int RpcServer::getInFlight()
+{
+    return inFlight;
+}
+
+
+
+/*
+    Set queue delay shedding for the pool of workers
+*/
+RpcServer* RpcServer::setShedding
+(
+    unsigned long long aTarget,     /* Target delay mcs */
+    unsigned long long aInterval    /* Interval mcs */
+)
+{
+    lock_guard <mutex> lock( codelSync );
+    codelTarget = aTarget;
+    codelInterval = aInterval > 0 ? aInterval : RPC_CODEL_INTERVAL_MCS;
+    firstAboveTime = 0;
+    dropping = false;
+    dropCount = 0;
+    return this;
+}
+
+
+
+/*
+    Return count of calls answered with overloaded code
+*/
+unsigned long long RpcServer::getOverloadedCount()
+{
+    return overloadedCount;
+}
+
+
+
+/*
+    Return count of calls dropped by deadline
+*/
+unsigned long long RpcServer::getExpiredCount()
+{
+    return expiredCount;
+}
+
+
+
+/*
+    Return cache of answers
+*/
+RpcServerCache* RpcServer::getCache()
+{
+    return cache;
+}
+
+
+
+/*
+    Return registered method for name and id, create it
+*/
+RpcMethod* RpcServer::registerMethod
+(
+    string          aName,  /* Name */
+    unsigned int    aId     /* Id */
+)
+{
+    RpcMethod* result = NULL;
+
+    if( aId > RPC_METHOD_ID_MAX )
+    {
+        getLog()
+        -> warning( "Method id is over limit" )
+        -> prm( "name", aName )
+        -> prm( "id", ( long long ) aId )
+        -> lineEnd();
+    }
+    else
+    {
+        result = getMethod( aName );
+        if( result == NULL )
+        {
+            result = new RpcMethod();
+            result -> name = aName;
+            methods.push_back( result );
+            methodsByName[ aName ] = result;
+        }
+
+        if( aId > 0 )
+        {
+            if( methodsById.size() <= aId )
+            {
+                methodsById.resize( aId + 1, NULL );
+            }
+            result -> id = aId;
+            methodsById[ aId ] = result;
+        }
+    }
+    return result;
+}
+
+
+
+/*
+    Register method handler
+*/
+RpcServer* RpcServer::addMethod
+(
+    string              aName,      /* Name */
+    unsigned int        aId,        /* Id */
+    RpcMethodHandler    aHandler    /* Handler */
+)
+{
+    auto method = registerMethod( aName, aId );
+    if( method != NULL )
+    {
+        method -> handler = aHandler;
+    }
+    return this;
+}
+
+
+
+/*
+    Register handler of typed requests
+*/
+RpcServer* RpcServer::addTypedMethod
+(
+    string              aName,      /* Name */
+    unsigned int        aId,        /* Id */
+    RpcTypedHandler     aHandler    /* Handler */
+)
+{
+    auto method = registerMethod( aName, aId );
+    if( method != NULL )
+    {
+        method -> typedHandler = aHandler;
+    }
+    return this;
+}
+
+
+
+/*
+    Register handler of streamed requests
+*/
+RpcServer* RpcServer::addStreamMethod
+(
+    string              aName,      /* Name */
+    unsigned int        aId,        /* Id */
+    RpcMethodHandler    aHandler    /* Handler */
+)
+{
+    auto method = registerMethod( aName, aId );
+    if( method != NULL )
+    {
+        method -> streamHandler = aHandler;
+    }
+    return this;
+}
+
+
+
+/*
+    Return registered method by name or NULL
+*/
+RpcMethod* RpcServer::getMethod
+(
+    string aName
+)
+{
+    auto item = methodsByName.find( aName );
+    return item == methodsByName.end() ? NULL : item -> second;
+}
+
+
+
+/*
+    Return registered method by id or NULL
+*/
+RpcMethod* RpcServer::getMethod
+(
+    unsigned int aId
+)
+{
+    return aId < methodsById.size() ? methodsById[ aId ] : NULL;
+}
+
+
+
+/*
+    Return list of registered methods
+*/
+vector <RpcMethod*>& RpcServer::getMethods()
+{
+    return methods;
+}
+
+
+
+/*
+    Set hook before handlers of methods
+*/
+RpcServer* RpcServer::setOnMethodBefore
+(
+    OnMethodBefore a
+)
+{
+    onMethodBefore = a;
+    return this;
+}
+
+
+
+/*
+    Set hook after handlers of methods
+*/
+RpcServer* RpcServer::setOnMethodAfter
+(
+    OnMethodAfter a
+)
+{
+    onMethodAfter = a;
+    return this;
+}
+
+
+
+/*
+    Return registered method of the call or NULL
+    Id of v2 header is looked up in the dense table, name is looked
+    up in the hash table only when the id is not registered
+*/
+RpcMethod* RpcServer::findMethod
+(
+    RpcServerCall& aCall
+)
+{
+    auto result = getMethod( aCall.header.methodId );
+
+    if
+    (
+        result == NULL &&
+        !methodsByName.empty() &&
+        !( aCall.header.flags & RPC_FLAG_TYPED )
+    )
+    {
+        result = getMethod( aCall.getArguments() -> getString( "method" ));
+    }
+
+    return result;
+}
+
+
+
+/*
+    Call registered method with limits, hooks and statistics
+*/
+RpcServer* RpcServer::callMethod
+(
+    RpcMethod*      aMethod,
+    RpcServerCall&  aCall
+)
+{
+    auto start = now();
+    aMethod -> callCount++;
+
+    bool run = true;
+
+    if
+    (
+        aMethod -> maxArgumentsSize > 0 &&
+        aCall.header.argumentsSize > aMethod -> maxArgumentsSize
+    )
+    {
+        aCall.answer -> setString
+        (
+            Path{ "result", "code" },
+            "method_arguments_over_limit"
+        );
+        run = false;
+    }
+
+    if( run && onMethodBefore )
+    {
+        run = onMethodBefore( aMethod, aCall );
+    }
+
+    if( run && aCall.typed )
+    {
+        /* Answer keeps the code, typed answer goes to the client */
+        auto valid = aMethod -> typedHandler
+        (
+            aCall.payloadView == NULL ? aCall.payload.data() : aCall.payloadView,
+            aCall.payloadSize,
+            aCall.typedAnswer
+        );
+        aCall.answer -> setString
+        (
+            Path{ "result", "code" },
+            valid ? "ok" : "typed_arguments_not_valid"
+        );
+    }
+    else if( run && ( aCall.header.flags & RPC_FLAG_STREAM ))
+    {
+        if( aMethod -> streamHandler == NULL )
+        {
+            aCall.answer -> setString
+            (
+                Path{ "result", "code" },
+                "method_is_not_streamed"
+            );
+        }
+        else
+        {
+            aMethod -> streamHandler( aCall.getArguments(), aCall.answer );
+        }
+    }
+    else if( run && aMethod -> handler == NULL )
+    {
+        aCall.answer -> setString
+        (
+            Path{ "result", "code" },
+            aMethod -> typedHandler == NULL
+            ? "method_is_streamed"
+            : "method_is_typed"
+        );
+    }
+    else if( run )
+    {
+        aMethod -> handler( aCall.getArguments(), aCall.answer );
+    }
+    else
+    {
+        aMethod -> rejectCount++;
+    }
+
+    if( aCall.answer -> getString( Path{ "result", "code" }) != "ok" )
+    {
+        aMethod -> errorCount++;
+    }
+
+    /* Time of call */
+    unsigned long long mcs = now() - start;
+    aMethod -> totalMcs += mcs;
+    auto maxMcs = aMethod -> maxMcs.load();
+    while( mcs > maxMcs && !aMethod -> maxMcs.compare_exchange_weak( maxMcs, mcs ));
+
+    if( onMethodAfter )
+    {
+        onMethodAfter( aMethod, aCall, mcs );
+    }
+
+    return this;
+}
+
+
+
+/*
+    On call event
+    Method may be ovverided
+*/
+bool RpcServer::onCallBefore
+(
+    string aIp /* client ip address */
+)
+{
+//    getLog() -> trace( "RPC" ) -> prm( "ip", aIp );
+    return true;
+}
+
+
+
+/*
+    Servers On call after event
+    Method may be ovverided
+*/
+RpcServer* RpcServer::onCallAfter
+(
+    ParamList* aArguments,
+    ParamList* aResults
+
+)
+{
+//    getLog() -> trace( "onCallAfter" );
+    aResults -> setString( "Answer", "Hello world!" );
+    return this;
+}
+
+
+
+
+/*
+    Servers On error event
+*/
+bool RpcServer::onError
+(
+    Result* aResult
+)
+{
+    getLog()
+    -> warning( "Server error" )
+    -> prm( "code", aResult -> getCode() )
+    -> prm( "message", aResult -> getMessage() )
+    -> dump( aResult -> getDetails() )
+    ;
+
+    return true;
+}
+
+
+
+/*
+    Read error of one client connection
+*/
+bool RpcServer::onReadError
+(
+    Result* aResult,
+    SockBuffer*
+)
+{
+    return onError( aResult );
+}
+
+
+
+/*
+    Write error of one client connection
+*/
+bool RpcServer::onWriteError
+(
+    Result* aResult
+)
+{
+    return onError( aResult );
+}
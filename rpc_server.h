@@ -5,19 +5,356 @@
 
 
 
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+
 #include "sock_rpc.h"
+#include "rpc_server_pool.h"
+#include "rpc_server_cache.h"
 
 #include "../json/param_list.h"
 
 
 
+/*
+    Admission control
+    Queue delay shedding follows CoDel: when delay of calls in the pool
+    queue stays over the target for the interval, calls are answered
+    with "overloaded" at growing rate until the delay goes down.
+*/
+#define RPC_OVERLOADED              "overloaded"
+#define RPC_CODEL_TARGET_MCS        5000    /* Recommended target delay */
+#define RPC_CODEL_INTERVAL_MCS      100000  /* Recommended interval */
+
+
+
+struct RpcMethod;
+
+
+
+/*
+    Call of the server
+    Keeps request and answer while the answer is not written.
+    Arguments are decoded from the serialized payload on the first
+    getArguments, so calls answered without the handler and calls
+    routed by header method id skip the decode in the listen loop.
+    Arguments of typed calls are empty, their payload is the struct.
+*/
+struct RpcServerCall
+{
+    int                 handle      = -1;   /* Handle of the client connection */
+    unsigned long long  serial      = 0;    /* Serial of the client connection */
+    SockRpcHeader       header;             /* Header of the request */
+    ParamList*          arguments   = NULL; /* Decoded arguments or NULL */
+    const char*         payloadView = NULL; /* Serialized arguments in the read buffer */
+    size_t              payloadSize = 0;
+    string              payload;            /* Own serialized arguments after reading */
+    ParamList*          answer      = NULL;
+    RpcMethod*          method      = NULL; /* Registered method or NULL */
+    long long           moment      = 0;    /* Moment of reading */
+    long long           deadline    = 0;    /* Moment of the end of budget, 0 without deadline */
+    bool                admitted    = false;/* Call is counted in flight */
+    bool                cacheable   = false;/* Answer goes to the cache */
+    bool                typed       = false;/* Request has typed payload */
+    string              typedAnswer;        /* Typed answer of the handler */
+    unsigned long long  cacheKey    = 0;
+
+
+
+    /*
+        Return arguments, they are decoded on the first call
+    */
+    ParamList* getArguments();
+
+
+
+    /*
+        Copy serialized arguments from the read buffer
+        Call must do it before it leaves the reading
+    */
+    RpcServerCall& keepPayload();
+};
+
+
+
+/* Maximum id of the dense table of methods */
+#define RPC_METHOD_ID_MAX 65535
+
+
+
+/*
+    Method handler
+*/
+typedef std::function< void ( ParamList*, ParamList* )> RpcMethodHandler;
+
+
+
+/*
+    Typed method handler
+    Handler receives the typed payload and writes the typed answer,
+    it returns false when the payload is not valid
+*/
+typedef std::function< bool ( const char*, size_t, string& )> RpcTypedHandler;
+
+
+
+/*
+    Registered method of the server
+    Method is found by id of v2 header with dense table or by "method"
+    argument with hash table. Statistics are updated by the server.
+*/
+struct RpcMethod
+{
+    string                          name                = "";
+    unsigned int                    id                  = 0;    /* 0 for name only */
+    RpcMethodHandler                handler             = NULL;
+    RpcTypedHandler                 typedHandler        = NULL; /* Handler of typed requests */
+    RpcMethodHandler                streamHandler       = NULL; /* Handler of streamed requests */
+
+    /* Limits, 0 is unlimited */
+    size_t                          maxArgumentsSize    = 0;    /* Payload bytes on wire */
+    unsigned int                    maxInFlight         = 0;    /* Calls at the same time */
+
+    /* Cache of answers with code ok, TTL 0 is off */
+    unsigned long long              cacheTtlMcs         = 0;
+    size_t                          cacheMaxAnswerSize  = 0;    /* Bytes of one answer */
+
+    /* Calls at the same time */
+    atomic <unsigned int>           inFlight            { 0 };
+
+    /* Statistics */
+    atomic <unsigned long long>     callCount           { 0 };
+    atomic <unsigned long long>     errorCount          { 0 };  /* Answers with code not ok */
+    atomic <unsigned long long>     rejectCount         { 0 };  /* Calls over limits */
+    atomic <unsigned long long>     expiredCount        { 0 };  /* Calls over deadline */
+    atomic <unsigned long long>     totalMcs            { 0 };
+    atomic <unsigned long long>     maxMcs              { 0 };
+    atomic <unsigned long long>     cacheHitCount       { 0 };
+    atomic <unsigned long long>     cacheMissCount      { 0 };
+};
+
+
+
 /*
     Server class definition
 */
 class RpcServer : public SockRpc
 {
+    public:
+
+        /*
+            Deferred handler
+            Handler fills the answer and calls done from any thread,
+            the answer is written by the listen loop
+        */
+        typedef std::function
+        <
+            void
+            (
+                ParamList*,                 /* Arguments */
+                ParamList*,                 /* Answer */
+                std::function< void () >    /* Done */
+            )
+        > OnCallDeferred;
+
+        /*
+            Method hook before the handler
+            Return false to reject the call, hook fills the answer.
+            Hook reads arguments by RpcServerCall::getArguments.
+        */
+        typedef std::function< bool ( RpcMethod*, RpcServerCall& )> OnMethodBefore;
+
+        /*
+            Method hook after the handler with time of call
+        */
+        typedef std::function
+        <
+            void
+            (
+                RpcMethod*,
+                RpcServerCall&,
+                unsigned long long  /* Time of call in microseconds */
+            )
+        > OnMethodAfter;
+
     private:
 
+        /* Workers for handlers or NULL for listen loop */
+        RpcServerPool* pool = NULL;
+
+        /* Current streamed call of the listen loop or NULL */
+        RpcServerCall* streamCall = NULL;
+
+        /* Deferred handler or NULL for onCallAfter */
+        OnCallDeferred onCallDeferred = NULL;
+
+        /* Registered methods */
+        vector <RpcMethod*>                     methods;
+        vector <RpcMethod*>                     methodsById;    /* Dense table by id */
+        unordered_map <string, RpcMethod*>      methodsByName;
+
+        /* Method hooks */
+        OnMethodBefore  onMethodBefore  = NULL;
+        OnMethodAfter   onMethodAfter   = NULL;
+
+        /* Finished calls waiting for writing in the listen loop */
+        mutex                   finishedSync;
+        vector <RpcServerCall>  finished;
+
+        /* Work of other threads for the listen loop */
+        mutex                               scheduledSync;
+        vector <std::function< void () >>   scheduled;
+
+        /* Cache of answers */
+        RpcServerCache*                 cache           = NULL;
+
+        /* Admission control, 0 is unlimited */
+        unsigned int                    maxInFlight     = 0;
+        atomic <unsigned int>           inFlight        { 0 };
+        atomic <unsigned long long>     overloadedCount { 0 };
+
+        /* Calls dropped by deadline of the client */
+        atomic <unsigned long long>     expiredCount    { 0 };
+
+        /* Queue delay shedding, target 0 is off */
+        mutex                           codelSync;
+        unsigned long long              codelTarget     = 0;
+        unsigned long long              codelInterval   = RPC_CODEL_INTERVAL_MCS;
+        long long                       firstAboveTime  = 0;
+        long long                       dropNext        = 0;
+        unsigned int                    dropCount       = 0;
+        bool                            dropping        = false;
+
+
+
+        /*
+            Count the call in flight if limits allow it
+            Return false for the overloaded server
+        */
+        bool admit
+        (
+            RpcServerCall&
+        );
+
+
+
+        /*
+            Return true if the call waited in the queue too long
+            and must be shed
+        */
+        bool shed
+        (
+            RpcServerCall&
+        );
+
+
+
+        /*
+            Answer the call with overloaded code
+        */
+        RpcServer* overload
+        (
+            RpcServerCall&
+        );
+
+
+
+        /*
+            Answer the call with deadline exceeded code when
+            the budget of the client is over
+            Return true if the call is expired
+        */
+        bool expire
+        (
+            RpcServerCall&
+        );
+
+
+
+        /*
+            Return registered method for name and id, create it
+            Return NULL when id is over limit
+        */
+        RpcMethod* registerMethod
+        (
+            string,         /* Name */
+            unsigned int    /* Id */
+        );
+
+
+
+        /*
+            Return registered method of the call or NULL
+        */
+        RpcMethod* findMethod
+        (
+            RpcServerCall&
+        );
+
+
+
+        /*
+            Call registered method with limits, hooks and statistics
+        */
+        RpcServer* callMethod
+        (
+            RpcMethod*,
+            RpcServerCall&
+        );
+
+
+
+        /*
+            Call registered method, onCallStreamAfter for streams or onCall
+        */
+        RpcServer* runCall
+        (
+            RpcMethod*,     /* Method or NULL */
+            RpcServerCall&
+        );
+
+
+
+        /*
+            Queue finished call for writing by the listen loop
+            Thread safe
+        */
+        RpcServer* finish
+        (
+            RpcServerCall&
+        );
+
+
+
+        /*
+            Return header of the answer for the request
+        */
+        SockRpcHeader getAnswerHeader
+        (
+            SockRpcHeader&  /* Request header */
+        );
+
+
+
+        /*
+            Write answer of the call to the client
+        */
+        RpcServer* writeAnswer
+        (
+            RpcServerCall&
+        );
+
+
+
+        /*
+            Write answers of finished calls
+            Method may not be overrided
+        */
+        virtual RpcServer* onListenLoop() final;
+
 
         /*
             On before read
@@ -59,6 +396,13 @@ class RpcServer : public SockRpc
 
 
 
+        /*
+            Destructor
+        */
+        ~RpcServer();
+
+
+
         /*
             Create socket
         */
@@ -87,6 +431,183 @@ class RpcServer : public SockRpc
 
 
 
+        /*
+            Set pool of workers for handlers
+            Handlers of registered methods and onCallAfter run on
+            workers and must be thread safe, streamed calls run in
+            the listen loop. NULL runs handlers in the listen loop.
+        */
+        RpcServer* setPool
+        (
+            RpcServerPool*
+        );
+
+
+
+        /*
+            Return pool of workers or NULL
+        */
+        RpcServerPool* getPool();
+
+
+
+        /*
+            Set limit of calls at the same time for all methods
+            Limit of one method is maxInFlight field of RpcMethod.
+            Calls over limits are answered with "overloaded" at once.
+            0 is unlimited.
+        */
+        RpcServer* setMaxInFlight
+        (
+            unsigned int
+        );
+
+
+
+        /*
+            Return limit of calls at the same time
+        */
+        unsigned int getMaxInFlight();
+
+
+
+        /*
+            Return count of calls at the same time
+        */
+        unsigned int getInFlight();
+
+
+
+        /*
+            Set queue delay shedding for the pool of workers
+            Target 0 turns shedding off.
+            RPC_CODEL_TARGET_MCS and RPC_CODEL_INTERVAL_MCS are good
+            values for most servers.
+        */
+        RpcServer* setShedding
+        (
+            unsigned long long,                         /* Target delay mcs */
+            unsigned long long = RPC_CODEL_INTERVAL_MCS /* Interval mcs */
+        );
+
+
+
+        /*
+            Return count of calls answered with overloaded code
+        */
+        unsigned long long getOverloadedCount();
+
+
+
+        /*
+            Return count of calls dropped by deadline
+        */
+        unsigned long long getExpiredCount();
+
+
+
+        /*
+            Return cache of answers
+            Methods are cached by cacheTtlMcs field of RpcMethod
+        */
+        RpcServerCache* getCache();
+
+
+
+        /*
+            Register method handler
+            Method is called by name from "method" argument or by id
+            of v2 header. Id 0 registers the name only. Requests for
+            unknown methods go to onCallAfter.
+        */
+        RpcServer* addMethod
+        (
+            string,             /* Name */
+            unsigned int,       /* Id */
+            RpcMethodHandler    /* Handler */
+        );
+
+
+
+        /*
+            Register handler of typed requests
+            Typed requests are routed by id only, the method may have
+            the ParamList handler as well for dynamic callers.
+            rpcTypedHandler of rpc_typed.h builds the handler from
+            the function of request and answer structs.
+        */
+        RpcServer* addTypedMethod
+        (
+            string,             /* Name */
+            unsigned int,       /* Id */
+            RpcTypedHandler     /* Handler */
+        );
+
+
+
+        /*
+            Register handler of streamed requests
+            Handler sends chunks with emit, the answer ends the stream.
+            Streamed requests for the method without this handler are
+            answered with method_is_not_streamed.
+        */
+        RpcServer* addStreamMethod
+        (
+            string,             /* Name */
+            unsigned int,       /* Id */
+            RpcMethodHandler    /* Handler */
+        );
+
+
+
+        /*
+            Return registered method by name or NULL
+            Limits of the method may be set by its fields
+        */
+        RpcMethod* getMethod
+        (
+            string
+        );
+
+
+
+        /*
+            Return registered method by id or NULL
+        */
+        RpcMethod* getMethod
+        (
+            unsigned int
+        );
+
+
+
+        /*
+            Return list of registered methods
+        */
+        vector <RpcMethod*>& getMethods();
+
+
+
+        /*
+            Set hook before handlers of methods
+        */
+        RpcServer* setOnMethodBefore
+        (
+            OnMethodBefore
+        );
+
+
+
+        /*
+            Set hook after handlers of methods
+        */
+        RpcServer* setOnMethodAfter
+        (
+            OnMethodAfter
+        );
+
+
+
         /*
             Server on call before event
             Method may be ovverided
@@ -110,6 +631,74 @@ class RpcServer : public SockRpc
 
 
 
+        /*
+            Server on call event for unregistered methods
+            Call has the request header, so handler may route v2
+            requests by method id without reading of arguments. Handler
+            runs on the thread of the call. Default handler calls
+            onCallAfter.
+            Method may be overrided
+        */
+        virtual RpcServer* onCall
+        (
+            RpcServerCall&  /* Call */
+        );
+
+
+
+        /*
+            Server on streamed call event
+            Handler sends chunks with emit while they are produced,
+            the answer is sent as the last frame of the stream.
+            Streamed requests for registered methods go to their stream
+            handlers. Default handler calls onCallAfter.
+            Method may be overrided
+        */
+        virtual RpcServer* onCallStreamAfter
+        (
+            ParamList*, /* Arguments */
+            ParamList*  /* Answer */
+        );
+
+
+
+        /*
+            Send chunk of the streamed answer to the client at once
+            Valid in onCallStreamAfter and stream handlers of methods
+            only, chunk may be reused
+            after the call
+        */
+        RpcServer* emit
+        (
+            ParamList*  /* Chunk */
+        );
+
+
+
+        /*
+            Set deferred handler instead of onCallAfter
+            Handler may finish the call later from another thread,
+            coroutine handlers of rpc_coroutine.h use it
+        */
+        RpcServer* setOnCallDeferred
+        (
+            OnCallDeferred
+        );
+
+
+
+        /*
+            Run function on the listen loop
+            Thread safe, coroutine handlers of rpc_coroutine.h resume
+            by it. Functions scheduled after down are not run.
+        */
+        RpcServer* schedule
+        (
+            std::function< void () >
+        );
+
+
+
         /*
             Servers On error event
         */
@@ -118,5 +707,28 @@ class RpcServer : public SockRpc
             Result*
         );
 
+
+
+        /*
+            Read error of one client connection
+            Server reports it and keeps listening
+        */
+        virtual bool onReadError
+        (
+            Result*,
+            SockBuffer*
+        );
+
+
+
+        /*
+            Write error of one client connection
+            Server reports it and keeps listening
+        */
+        virtual bool onWriteError
+        (
+            Result*
+        );
+
 };
 
@@ -0,0 +1,245 @@
+#include "rpc_server_cache.h"
+
+
+
+using namespace std;
+
+
+
+/*
+    Create cache
+*/
+RpcServerCache* RpcServerCache::create()
+{
+    return new RpcServerCache();
+}
+
+
+
+/*
+    Destroy cache
+*/
+void RpcServerCache::destroy()
+{
+    delete this;
+}
+
+
+
+/*
+    Return key for method and serialized arguments
+*/
+unsigned long long RpcServerCache::calcKey
+(
+    unsigned int    aMethodId,  /* Method id */
+    const char*     aArguments, /* Arguments */
+    size_t          aSize       /* Size of arguments */
+)
+{
+    /* FNV-1a 64 */
+    unsigned long long result = 14695981039346656037ULL;
+    for( size_t i = 0; i < aSize; i++ )
+    {
+        result ^= ( unsigned char ) aArguments[ i ];
+        result *= 1099511628211ULL;
+    }
+    return result ^ (( unsigned long long ) aMethodId * 0x9E3779B97F4A7C15ULL );
+}
+
+
+
+/*
+    Remove entry
+*/
+RpcServerCache* RpcServerCache::remove
+(
+    unordered_map <unsigned long long, RpcServerCacheEntry>::iterator aEntry
+)
+{
+    size -= aEntry -> second.arguments.size() + aEntry -> second.answer.size();
+    order.erase( aEntry -> second.order );
+    entries.erase( aEntry );
+    return this;
+}
+
+
+
+/*
+    Return live entry for key and arguments or NULL
+*/
+RpcServerCacheEntry* RpcServerCache::get
+(
+    unsigned long long  aKey,       /* Key */
+    unsigned int        aMethodId,  /* Method id */
+    const char*         aArguments, /* Arguments */
+    size_t              aSize,      /* Size of arguments */
+    long long           aMoment     /* Moment */
+)
+{
+    RpcServerCacheEntry* result = NULL;
+
+    auto item = entries.find( aKey );
+    if( item != entries.end() )
+    {
+        auto& entry = item -> second;
+        if( entry.expire <= aMoment )
+        {
+            /* Entry is dead */
+            remove( item );
+        }
+        else if
+        (
+            entry.methodId == aMethodId &&
+            entry.arguments.size() == aSize &&
+            entry.arguments.compare( 0, aSize, aArguments, aSize ) == 0
+        )
+        {
+            /* Entry goes to the head of LRU */
+            order.splice( order.begin(), order, entry.order );
+            hitCount++;
+            result = &entry;
+        }
+    }
+
+    return result;
+}
+
+
+
+/*
+    Put answer for key and arguments
+*/
+RpcServerCache* RpcServerCache::put
+(
+    unsigned long long  aKey,           /* Key */
+    unsigned int        aMethodId,      /* Method id */
+    RpcMethod*          aMethod,        /* Method of the answer */
+    const string&       aArguments,     /* Arguments */
+    const char*         aAnswer,        /* Answer */
+    size_t              aAnswerSize,    /* Size of answer */
+    long long           aExpire         /* Moment of the end of life */
+)
+{
+    auto entrySize = aArguments.size() + aAnswerSize;
+
+    if( entrySize <= maxSize )
+    {
+        /* Old entry of the key or collision */
+        auto item = entries.find( aKey );
+        if( item != entries.end() )
+        {
+            remove( item );
+        }
+
+        /* The least recently used entries go out */
+        while( size + entrySize > maxSize && !order.empty() )
+        {
+            remove( entries.find( order.back() ));
+        }
+
+        order.push_front( aKey );
+        auto& entry = entries[ aKey ];
+        entry.key       = aKey;
+        entry.methodId  = aMethodId;
+        entry.method    = aMethod;
+        entry.arguments = aArguments;
+        entry.answer.assign( aAnswer, aAnswerSize );
+        entry.expire    = aExpire;
+        entry.order     = order.begin();
+        size += entrySize;
+    }
+
+    return this;
+}
+
+
+
+/*
+    Remove all entries
+*/
+RpcServerCache* RpcServerCache::clear()
+{
+    entries.clear();
+    order.clear();
+    size = 0;
+    return this;
+}
+
+
+
+/*
+    Set limit of bytes of entries
+*/
+RpcServerCache* RpcServerCache::setMaxSize
+(
+    size_t a
+)
+{
+    maxSize = a;
+    while( size > maxSize && !order.empty() )
+    {
+        remove( entries.find( order.back() ));
+    }
+    return this;
+}
+
+
+
+/*
+    Return limit of bytes of entries
+*/
+size_t RpcServerCache::getMaxSize()
+{
+    return maxSize;
+}
+
+
+
+/*
+    Return bytes of entries
+*/
+size_t RpcServerCache::getSize()
+{
+    return size;
+}
+
+
+
+/*
+    Return count of entries
+*/
+size_t RpcServerCache::getCount()
+{
+    return entries.size();
+}
+
+
+
+/*
+    Return count of hits
+*/
+unsigned long long RpcServerCache::getHitCount()
+{
+    return hitCount;
+}
+
+
+
+/*
+    Return count of misses
+*/
+unsigned long long RpcServerCache::getMissCount()
+{
+    return missCount;
+}
+
+
+
+/*
+    Count miss of the cacheable call
+*/
+RpcServerCache* RpcServerCache::miss()
+{
+    missCount++;
+    return this;
+}
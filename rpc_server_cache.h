@@ -0,0 +1,190 @@
+#pragma once
+
+
+/*
+    Cache of serialized answers for RpcServer
+    Key is method id of the header and FNV-1a hash of serialized
+    arguments as they came from the network. Entry keeps arguments for
+    check of hash collisions and the serialized answer, so the hit is
+    written without ParamList decode, handler call and encode. Old
+    entries are removed by TTL and by LRU when the cache is over size.
+    Cache is used by the listen loop thread only.
+*/
+
+
+
+#include <string>
+#include <list>
+#include <unordered_map>
+
+
+
+using namespace std;
+
+
+
+#define RPC_SERVER_CACHE_SIZE 67108864  /* Bytes of entries, 64 MB */
+
+
+
+struct RpcMethod;
+
+
+
+/*
+    Entry of the cache
+*/
+struct RpcServerCacheEntry
+{
+    unsigned long long              key         = 0;
+    unsigned int                    methodId    = 0;
+    RpcMethod*                      method      = NULL; /* Method of the answer */
+    string                          arguments   = "";
+    string                          answer      = "";
+    long long                       expire      = 0;    /* Moment of the end of life */
+    list <unsigned long long>::iterator order;          /* Position in LRU list */
+};
+
+
+
+class RpcServerCache
+{
+    private:
+
+        unordered_map <unsigned long long, RpcServerCacheEntry> entries;
+
+        /* Keys from the last used to the oldest */
+        list <unsigned long long>   order;
+
+        /* Bytes of entries and their limit */
+        size_t                      size        = 0;
+        size_t                      maxSize     = RPC_SERVER_CACHE_SIZE;
+
+        /* Statistics */
+        unsigned long long          hitCount    = 0;
+        unsigned long long          missCount   = 0;
+
+        /*
+            Remove entry
+        */
+        RpcServerCache* remove
+        (
+            unordered_map <unsigned long long, RpcServerCacheEntry>::iterator
+        );
+
+    public:
+
+        /*
+            Create cache
+        */
+        static RpcServerCache* create();
+
+
+
+        /*
+            Destroy cache
+        */
+        void destroy();
+
+
+
+        /*
+            Return key for method and serialized arguments
+        */
+        static unsigned long long calcKey
+        (
+            unsigned int,   /* Method id */
+            const char*,    /* Arguments */
+            size_t          /* Size of arguments */
+        );
+
+
+
+        /*
+            Return live entry for key and arguments or NULL
+            Entry is valid until the next put
+        */
+        RpcServerCacheEntry* get
+        (
+            unsigned long long, /* Key */
+            unsigned int,       /* Method id */
+            const char*,        /* Arguments */
+            size_t,             /* Size of arguments */
+            long long           /* Moment */
+        );
+
+
+
+        /*
+            Put answer for key and arguments
+        */
+        RpcServerCache* put
+        (
+            unsigned long long, /* Key */
+            unsigned int,       /* Method id */
+            RpcMethod*,         /* Method of the answer */
+            const string&,      /* Arguments */
+            const char*,        /* Answer */
+            size_t,             /* Size of answer */
+            long long           /* Moment of the end of life */
+        );
+
+
+
+        /*
+            Remove all entries
+        */
+        RpcServerCache* clear();
+
+
+
+        /*
+            Set limit of bytes of entries
+        */
+        RpcServerCache* setMaxSize
+        (
+            size_t
+        );
+
+
+
+        /*
+            Return limit of bytes of entries
+        */
+        size_t getMaxSize();
+
+
+
+        /*
+            Return bytes of entries
+        */
+        size_t getSize();
+
+
+
+        /*
+            Return count of entries
+        */
+        size_t getCount();
+
+
+
+        /*
+            Return count of hits
+        */
+        unsigned long long getHitCount();
+
+
+
+        /*
+            Return count of misses
+        */
+        unsigned long long getMissCount();
+
+
+
+        /*
+            Count miss of the cacheable call
+        */
+        RpcServerCache* miss();
+};
@@ -0,0 +1,277 @@
+#include "rpc_server_pool.h"
+
+
+
+using namespace std;
+
+
+
+/*
+    Constructor
+*/
+RpcServerPool::RpcServerPool
+(
+    unsigned int    aSize,      /* Count of workers */
+    size_t          aQueueSize  /* Count of waiting tasks */
+)
+{
+    size = aSize > 0 ? aSize : 1;
+    queueSize = aQueueSize;
+
+    /* Each worker has own part of the queue */
+    for( unsigned int i = 0; i < size; i++ )
+    {
+        queues.push_back( new RpcServerQueue(( queueSize + size - 1 ) / size ));
+    }
+}
+
+
+
+/*
+    Destructor
+*/
+RpcServerPool::~RpcServerPool()
+{
+    stop();
+    for( auto queue : queues )
+    {
+        delete queue;
+    }
+}
+
+
+
+/*
+    Create pool
+*/
+RpcServerPool* RpcServerPool::create
+(
+    unsigned int    aSize,      /* Count of workers */
+    size_t          aQueueSize  /* Count of waiting tasks */
+)
+{
+    return new RpcServerPool( aSize, aQueueSize );
+}
+
+
+
+/*
+    Destroy pool
+*/
+void RpcServerPool::destroy()
+{
+    delete this;
+}
+
+
+
+/*
+    Start workers
+*/
+RpcServerPool* RpcServerPool::start()
+{
+    if( !running )
+    {
+        running = true;
+        for( unsigned int i = 0; i < size; i++ )
+        {
+            workers.push_back( new thread( [ this, i ]{ work( i ); } ));
+        }
+    }
+    return this;
+}
+
+
+
+/*
+    Stop workers
+*/
+RpcServerPool* RpcServerPool::stop()
+{
+    if( running )
+    {
+        sync.lock();
+        running = false;
+        sync.unlock();
+        wakeup.notify_all();
+
+        for( auto worker : workers )
+        {
+            worker -> join();
+            delete worker;
+        }
+        workers.clear();
+    }
+    return this;
+}
+
+
+
+/*
+    Push task to the pool
+*/
+bool RpcServerPool::push
+(
+    Task            aTask,
+    unsigned int    aKey    /* Key of worker, handle of connection */
+)
+{
+    bool result = false;
+
+    /* Counter goes first, so workers never see it below tasks */
+    waitingCount++;
+
+    if( running )
+    {
+        /* Worker of the key first, the next ones when it is full */
+        for( unsigned int i = 0; i < size && !result; i++ )
+        {
+            result = queues[( aKey + i ) % size ] -> push( aTask );
+        }
+    }
+
+    if( result )
+    {
+        /* Lock prevents lost wake up of the falling asleep worker */
+        if( sleepingCount > 0 )
+        {
+            sync.lock();
+            sync.unlock();
+            wakeup.notify_one();
+        }
+    }
+    else
+    {
+        waitingCount--;
+        rejectedCount++;
+    }
+
+    return result;
+}
+
+
+
+/*
+    Pop task from own queue or steal it from others
+*/
+bool RpcServerPool::take
+(
+    unsigned int    aIndex, /* Index of worker */
+    Task&           aTask
+)
+{
+    bool result = queues[ aIndex ] -> pop( aTask );
+
+    for( unsigned int i = 1; i < size && !result; i++ )
+    {
+        result = queues[( aIndex + i ) % size ] -> pop( aTask );
+        if( result )
+        {
+            stolenCount++;
+        }
+    }
+
+    if( result )
+    {
+        waitingCount--;
+    }
+
+    return result;
+}
+
+
+
+/*
+    Worker body
+*/
+void RpcServerPool::work
+(
+    unsigned int aIndex /* Index of worker */
+)
+{
+    Task task;
+    unsigned int attempts = 0;
+
+    while( true )
+    {
+        if( take( aIndex, task ))
+        {
+            attempts = 0;
+            task();
+            task = NULL;
+            doneCount++;
+        }
+        else if( !running )
+        {
+            /* Waiting tasks are done before stop */
+            break;
+        }
+        else if( ++attempts < RPC_SERVER_POOL_SPIN )
+        {
+            this_thread::yield();
+        }
+        else
+        {
+            /* Sleep until the next task */
+            unique_lock <mutex> lock( sync );
+            sleepingCount++;
+            wakeup.wait
+            (
+                lock,
+                [ this ]{ return !running || waitingCount > 0; }
+            );
+            sleepingCount--;
+            attempts = 0;
+        }
+    }
+}
+
+
+
+/*
+    Return count of workers
+*/
+unsigned int RpcServerPool::getSize()
+{
+    return size;
+}
+
+
+
+/*
+    Return count of waiting tasks
+*/
+size_t RpcServerPool::getQueueLength()
+{
+    return waitingCount;
+}
+
+
+
+/*
+    Return count of done tasks
+*/
+unsigned long long RpcServerPool::getDoneCount()
+{
+    return doneCount;
+}
+
+
+
+/*
+    Return count of tasks rejected by the full queue
+*/
+unsigned long long RpcServerPool::getRejectedCount()
+{
+    return rejectedCount;
+}
+
+
+
+/*
+    Return count of tasks stolen by idle workers
+*/
+unsigned long long RpcServerPool::getStolenCount()
+{
+    return stolenCount;
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+
+/*
+    Pool of worker threads for RpcServer handlers
+    Listen loop of the server reads and decodes requests and pushes
+    calls to the pool. Workers run handlers and return answers to the
+    listen loop for writing, so slow handlers do not stop reading of
+    other clients. Pool may be shared by many servers and must be
+    stopped before the servers are destroyed.
+    Each worker has own lock free queue. Calls of one connection go to
+    the same worker for cache locality, idle workers steal calls from
+    queues of other workers. Mutex is used only for sleeping of idle
+    workers.
+*/
+
+
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <functional>
+
+#include "rpc_server_queue.h"
+
+
+
+using namespace std;
+
+
+
+#define RPC_SERVER_POOL_SIZE        4       /* Count of workers */
+#define RPC_SERVER_POOL_QUEUE_SIZE  1024    /* Count of waiting tasks */
+#define RPC_SERVER_POOL_SPIN        64      /* Attempts to find task before sleep */
+
+
+
+class RpcServerPool
+{
+    public:
+
+        typedef RpcServerQueue::Task Task;
+
+    private:
+
+        /* Mutex for sleeping of idle workers */
+        mutex                           sync;
+        condition_variable              wakeup;
+        atomic <unsigned int>           sleepingCount   { 0 };
+
+        /* Queues of workers */
+        vector <RpcServerQueue*>        queues;
+        atomic <size_t>                 waitingCount    { 0 };
+
+        /* Workers */
+        vector <thread*>                workers;
+        atomic <bool>                   running         { false };
+
+        /* Configuration */
+        unsigned int                    size            = RPC_SERVER_POOL_SIZE;
+        size_t                          queueSize       = RPC_SERVER_POOL_QUEUE_SIZE;
+
+        /* Statistics */
+        atomic <unsigned long long>     doneCount       { 0 };
+        atomic <unsigned long long>     rejectedCount   { 0 };
+        atomic <unsigned long long>     stolenCount     { 0 };
+
+        /*
+            Worker body
+        */
+        void work
+        (
+            unsigned int    /* Index of worker */
+        );
+
+
+
+        /*
+            Pop task from own queue or steal it from others
+        */
+        bool take
+        (
+            unsigned int,   /* Index of worker */
+            Task&
+        );
+
+    public:
+
+        /*
+            Constructor
+        */
+        RpcServerPool
+        (
+            unsigned int,   /* Count of workers */
+            size_t          /* Count of waiting tasks */
+        );
+
+
+
+        /*
+            Destructor
+        */
+        ~RpcServerPool();
+
+
+
+        /*
+            Create pool
+        */
+        static RpcServerPool* create
+        (
+            unsigned int    = RPC_SERVER_POOL_SIZE,         /* Count of workers */
+            size_t          = RPC_SERVER_POOL_QUEUE_SIZE    /* Count of waiting tasks */
+        );
+
+
+
+        /*
+            Destroy pool
+        */
+        void destroy();
+
+
+
+        /*
+            Start workers
+        */
+        RpcServerPool* start();
+
+
+
+        /*
+            Stop workers
+            Waiting tasks are done before workers stop
+        */
+        RpcServerPool* stop();
+
+
+
+        /*
+            Push task to the pool
+            Thread safe. Tasks with the same key go to the same worker
+            while its queue is not full. Return false when all queues
+            are full.
+        */
+        bool push
+        (
+            Task,
+            unsigned int = 0    /* Key of worker, handle of connection */
+        );
+
+
+
+        /*
+            Return count of workers
+        */
+        unsigned int getSize();
+
+
+
+        /*
+            Return count of waiting tasks
+        */
+        size_t getQueueLength();
+
+
+
+        /*
+            Return count of done tasks
+        */
+        unsigned long long getDoneCount();
+
+
+
+        /*
+            Return count of tasks rejected by full queues
+        */
+        unsigned long long getRejectedCount();
+
+
+
+        /*
+            Return count of tasks stolen by idle workers
+        */
+        unsigned long long getStolenCount();
+};
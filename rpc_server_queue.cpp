@@ -0,0 +1,145 @@
+#include <cstdint>
+
+#include "rpc_server_queue.h"
+
+
+
+using namespace std;
+
+
+
+/*
+    Constructor
+*/
+RpcServerQueue::RpcServerQueue
+(
+    size_t aCapacity    /* Capacity, rounded up to power of two */
+)
+{
+    size_t capacity = 2;
+    while( capacity < aCapacity )
+    {
+        capacity <<= 1;
+    }
+
+    cells = new Cell[ capacity ];
+    mask = capacity - 1;
+
+    for( size_t i = 0; i < capacity; i++ )
+    {
+        cells[ i ].sequence.store( i, memory_order_relaxed );
+    }
+}
+
+
+
+/*
+    Destructor
+*/
+RpcServerQueue::~RpcServerQueue()
+{
+    delete [] cells;
+}
+
+
+
+/*
+    Push task
+*/
+bool RpcServerQueue::push
+(
+    Task& aTask
+)
+{
+    Cell* cell = NULL;
+    auto position = pushPosition.load( memory_order_relaxed );
+
+    while( true )
+    {
+        cell = &cells[ position & mask ];
+        auto sequence = cell -> sequence.load( memory_order_acquire );
+        auto difference = ( intptr_t ) sequence - ( intptr_t ) position;
+
+        if( difference == 0 )
+        {
+            /* Cell is free, take the position */
+            if
+            (
+                pushPosition.compare_exchange_weak
+                (
+                    position,
+                    position + 1,
+                    memory_order_relaxed
+                )
+            )
+            {
+                break;
+            }
+        }
+        else if( difference < 0 )
+        {
+            /* Cell is not popped yet, queue is full */
+            return false;
+        }
+        else
+        {
+            position = pushPosition.load( memory_order_relaxed );
+        }
+    }
+
+    cell -> task = move( aTask );
+    cell -> sequence.store( position + 1, memory_order_release );
+    return true;
+}
+
+
+
+/*
+    Pop task
+*/
+bool RpcServerQueue::pop
+(
+    Task& aTask
+)
+{
+    Cell* cell = NULL;
+    auto position = popPosition.load( memory_order_relaxed );
+
+    while( true )
+    {
+        cell = &cells[ position & mask ];
+        auto sequence = cell -> sequence.load( memory_order_acquire );
+        auto difference = ( intptr_t ) sequence - ( intptr_t )( position + 1 );
+
+        if( difference == 0 )
+        {
+            /* Cell is pushed, take the position */
+            if
+            (
+                popPosition.compare_exchange_weak
+                (
+                    position,
+                    position + 1,
+                    memory_order_relaxed
+                )
+            )
+            {
+                break;
+            }
+        }
+        else if( difference < 0 )
+        {
+            /* Cell is not pushed yet, queue is empty */
+            return false;
+        }
+        else
+        {
+            position = popPosition.load( memory_order_relaxed );
+        }
+    }
+
+    aTask = move( cell -> task );
+    cell -> task = NULL;
+    cell -> sequence.store( position + mask + 1, memory_order_release );
+    return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+
+/*
+    Bounded lock free queue of tasks for RpcServerPool
+    Multiple producers and consumers ring of D. Vyukov: each cell has
+    a sequence number, producers and consumers take positions by one
+    compare and swap and never wait for each other under lock. Each
+    worker of the pool has own queue, the listen loop pushes to it and
+    idle workers steal from it.
+*/
+
+
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+
+
+using namespace std;
+
+
+
+/* Size of cache line for separation of positions */
+#define RPC_SERVER_QUEUE_ALIGN 64
+
+
+
+class RpcServerQueue
+{
+    public:
+
+        typedef std::function< void () > Task;
+
+    private:
+
+        /*
+            Cell of the ring
+        */
+        struct Cell
+        {
+            atomic <size_t> sequence    { 0 };
+            Task            task        = NULL;
+        };
+
+        Cell*   cells   = NULL;
+        size_t  mask    = 0;
+
+        /* Positions are on own cache lines */
+        alignas( RPC_SERVER_QUEUE_ALIGN ) atomic <size_t> pushPosition { 0 };
+        alignas( RPC_SERVER_QUEUE_ALIGN ) atomic <size_t> popPosition { 0 };
+
+    public:
+
+        /*
+            Constructor
+        */
+        RpcServerQueue
+        (
+            size_t  /* Capacity, rounded up to power of two */
+        );
+
+
+
+        /*
+            Destructor
+        */
+        ~RpcServerQueue();
+
+
+
+        /*
+            Push task
+            Return false when the queue is full
+        */
+        bool push
+        (
+            Task&
+        );
+
+
+
+        /*
+            Pop task
+            Return false when the queue is empty
+        */
+        bool pop
+        (
+            Task&
+        );
+};
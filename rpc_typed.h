@@ -0,0 +1,435 @@
+#pragma once
+
+
+/*
+    Typed RPC for hot methods
+    Request and answer are plain structs with the constexpr list of
+    fields, they are encoded to compact binary form without ParamList:
+
+        struct SumRequest
+        {
+            int             a = 0;
+            int             b = 0;
+            vector <int>    rest;
+
+            static constexpr auto rpcFields()
+            {
+                return make_tuple
+                (
+                    &SumRequest::a,
+                    &SumRequest::b,
+                    &SumRequest::rest
+                );
+            }
+        };
+
+        server -> addTypedMethod
+        (
+            "sum",
+            7,
+            rpcTypedHandler < SumRequest, SumAnswer >
+            (
+                []( const SumRequest& aRequest, SumAnswer& aAnswer )
+                {
+                    aAnswer.sum = aRequest.a + aRequest.b;
+                }
+            )
+        );
+
+        rpcCallTyped( client, 7, request, answer );
+
+    Fields are encoded in the order of the list without names:
+        bool            1 byte
+        integer, enum   varint, signed values are zigzag encoded,
+                        values out of range of the field are not valid
+        float, double   little endian IEEE 754
+        string          varint size and bytes
+        vector          varint count and items
+        struct          fields of its rpcFields
+    Frames have RPC_FLAG_TYPED in the same v2 framing, the method may
+    keep the ParamList handler for dynamic callers.
+*/
+
+
+
+#include <string>
+#include <vector>
+#include <tuple>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <limits>
+
+#include "rpc_client.h"
+#include "rpc_server.h"
+
+
+
+using namespace std;
+
+
+
+/*
+    Codec of typed structs
+*/
+class RpcTyped
+{
+    private:
+
+        /*
+            True for vector
+        */
+        template < class T >
+        struct IsVector : false_type {};
+
+        template < class T, class A >
+        struct IsVector < vector < T, A >> : true_type {};
+
+
+
+        /*
+            Unsigned integer of the same size as the float
+        */
+        template < class T >
+        using FloatBits = typename conditional
+        <
+            sizeof( T ) == 4,
+            unsigned int,
+            unsigned long long
+        >::type;
+
+
+
+        /*
+            Write varint
+        */
+        static void putVarint
+        (
+            string&             aBuffer,    /* Buffer */
+            unsigned long long  aValue      /* Value */
+        )
+        {
+            while( aValue >= 0x80 )
+            {
+                aBuffer.push_back(( char )( aValue | 0x80 ));
+                aValue >>= 7;
+            }
+            aBuffer.push_back(( char ) aValue );
+        }
+
+
+
+        /*
+            Read varint
+            Return false at the end of buffer or for too long varint
+        */
+        static bool getVarint
+        (
+            const char*&        aCursor,    /* Cursor */
+            const char*         aEnd,       /* End of buffer */
+            unsigned long long& aValue      /* Value */
+        )
+        {
+            aValue = 0;
+            for( int shift = 0; shift < 64 && aCursor < aEnd; shift += 7 )
+            {
+                auto byte = ( unsigned char ) *aCursor++;
+                aValue |= ( unsigned long long )( byte & 0x7F ) << shift;
+                if(( byte & 0x80 ) == 0 )
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+
+
+    public:
+
+        /*
+            Append encoded value to buffer
+        */
+        template < class T >
+        static void encode
+        (
+            const T&    aValue,     /* Value */
+            string&     aBuffer     /* Buffer */
+        )
+        {
+            if constexpr( is_same < T, bool >::value )
+            {
+                aBuffer.push_back( aValue ? 1 : 0 );
+            }
+            else if constexpr( is_enum < T >::value )
+            {
+                encode(( typename underlying_type < T >::type ) aValue, aBuffer );
+            }
+            else if constexpr( is_integral < T >::value && is_signed < T >::value )
+            {
+                /* Zigzag keeps small negative values short */
+                auto value = ( long long ) aValue;
+                putVarint
+                (
+                    aBuffer,
+                    (( unsigned long long ) value << 1 ) ^ ( unsigned long long )( value >> 63 )
+                );
+            }
+            else if constexpr( is_integral < T >::value )
+            {
+                putVarint( aBuffer, ( unsigned long long ) aValue );
+            }
+            else if constexpr( is_floating_point < T >::value )
+            {
+                static_assert( sizeof( T ) == 4 || sizeof( T ) == 8, "Float must be 4 or 8 bytes" );
+                FloatBits < T > bits;
+                memcpy( &bits, &aValue, sizeof( T ));
+                for( size_t i = 0; i < sizeof( T ); i++ )
+                {
+                    aBuffer.push_back(( char )( bits >> ( i * 8 )));
+                }
+            }
+            else if constexpr( is_same < T, string >::value )
+            {
+                putVarint( aBuffer, aValue.size() );
+                aBuffer.append( aValue );
+            }
+            else if constexpr( IsVector < T >::value )
+            {
+                putVarint( aBuffer, aValue.size() );
+                /* Item of vector <bool> is a temporary bool */
+                for( const typename T::value_type& item : aValue )
+                {
+                    encode( item, aBuffer );
+                }
+            }
+            else
+            {
+                /* Struct with the list of fields */
+                apply
+                (
+                    [ &aValue, &aBuffer ]( auto... aFields )
+                    {
+                        ( encode( aValue.*aFields, aBuffer ), ... );
+                    },
+                    T::rpcFields()
+                );
+            }
+        }
+
+
+
+        /*
+            Read encoded value from cursor
+            Return false when buffer is not valid
+        */
+        template < class T >
+        static bool decode
+        (
+            const char*&    aCursor,    /* Cursor */
+            const char*     aEnd,       /* End of buffer */
+            T&              aValue      /* Value */
+        )
+        {
+            bool result = true;
+            unsigned long long value = 0;
+
+            if constexpr( is_same < T, bool >::value )
+            {
+                result = aCursor < aEnd;
+                if( result )
+                {
+                    aValue = *aCursor++ != 0;
+                }
+            }
+            else if constexpr( is_enum < T >::value )
+            {
+                typename underlying_type < T >::type item;
+                result = decode( aCursor, aEnd, item );
+                if( result )
+                {
+                    aValue = ( T ) item;
+                }
+            }
+            else if constexpr( is_integral < T >::value && is_signed < T >::value )
+            {
+                auto item = 0LL;
+                result = getVarint( aCursor, aEnd, value );
+                if( result )
+                {
+                    item = ( long long )( value >> 1 ) ^ -( long long )( value & 1 );
+                    result =
+                    item >= ( long long ) numeric_limits < T >::min() &&
+                    item <= ( long long ) numeric_limits < T >::max();
+                }
+                if( result )
+                {
+                    aValue = ( T ) item;
+                }
+            }
+            else if constexpr( is_integral < T >::value )
+            {
+                result =
+                getVarint( aCursor, aEnd, value ) &&
+                value <= ( unsigned long long ) numeric_limits < T >::max();
+                if( result )
+                {
+                    aValue = ( T ) value;
+                }
+            }
+            else if constexpr( is_floating_point < T >::value )
+            {
+                result = ( size_t )( aEnd - aCursor ) >= sizeof( T );
+                if( result )
+                {
+                    FloatBits < T > bits = 0;
+                    for( size_t i = 0; i < sizeof( T ); i++ )
+                    {
+                        bits |= ( FloatBits < T > )( unsigned char ) aCursor[ i ] << ( i * 8 );
+                    }
+                    memcpy( &aValue, &bits, sizeof( T ));
+                    aCursor += sizeof( T );
+                }
+            }
+            else if constexpr( is_same < T, string >::value )
+            {
+                result =
+                getVarint( aCursor, aEnd, value ) &&
+                value <= ( unsigned long long )( aEnd - aCursor );
+                if( result )
+                {
+                    aValue.assign( aCursor, value );
+                    aCursor += value;
+                }
+            }
+            else if constexpr( IsVector < T >::value )
+            {
+                /* Each item has one byte at least */
+                result =
+                getVarint( aCursor, aEnd, value ) &&
+                value <= ( unsigned long long )( aEnd - aCursor );
+                aValue.clear();
+                if( result )
+                {
+                    /* Item is decoded aside, vector <bool> has no references */
+                    aValue.reserve( value );
+                    for( unsigned long long i = 0; result && i < value; i++ )
+                    {
+                        typename T::value_type item {};
+                        result = decode( aCursor, aEnd, item );
+                        aValue.push_back( move( item ));
+                    }
+                }
+            }
+            else
+            {
+                /* Struct with the list of fields */
+                apply
+                (
+                    [ &aCursor, aEnd, &aValue, &result ]( auto... aFields )
+                    {
+                        (( result = result && decode( aCursor, aEnd, aValue.*aFields )), ... );
+                    },
+                    T::rpcFields()
+                );
+            }
+
+            return result;
+        }
+
+
+
+        /*
+            Return encoded struct
+        */
+        template < class T >
+        static string pack
+        (
+            const T& aValue
+        )
+        {
+            string result;
+            encode( aValue, result );
+            return result;
+        }
+
+
+
+        /*
+            Decode struct from buffer
+            Return false when buffer is not valid or has extra bytes
+        */
+        template < class T >
+        static bool unpack
+        (
+            const char* aBuffer,    /* Buffer */
+            size_t      aSize,      /* Size of buffer */
+            T&          aValue      /* Struct */
+        )
+        {
+            auto cursor = aBuffer;
+            auto end = aBuffer + aSize;
+            return decode( cursor, end, aValue ) && cursor == end;
+        }
+};
+
+
+
+/*
+    Return typed handler for RpcServer::addTypedMethod
+    Function receives the decoded request and fills the answer
+*/
+template < class Request, class Answer >
+inline RpcTypedHandler rpcTypedHandler
+(
+    std::function< void ( const Request&, Answer& ) > aHandler
+)
+{
+    return
+    [ aHandler ]
+    (
+        const char* aArguments,
+        size_t      aSize,
+        string&     aAnswer
+    )
+    {
+        Request request;
+        bool result = RpcTyped::unpack( aArguments, aSize, request );
+        if( result )
+        {
+            Answer answer;
+            aHandler( request, answer );
+            aAnswer.clear();
+            RpcTyped::encode( answer, aAnswer );
+        }
+        return result;
+    };
+}
+
+
+
+/*
+    Call typed method of the server
+    Error goes to the result code of the client
+*/
+template < class Request, class Answer >
+inline RpcClient* rpcCallTyped
+(
+    RpcClient*      aClient,    /* Client */
+    unsigned int    aMethodId,  /* Method id */
+    const Request&  aRequest,   /* Request */
+    Answer&         aAnswer     /* Answer */
+)
+{
+    string answer;
+    aClient -> callTyped( aMethodId, RpcTyped::pack( aRequest ), answer );
+    if
+    (
+        aClient -> isOk() &&
+        !RpcTyped::unpack( answer.data(), answer.size(), aAnswer )
+    )
+    {
+        aClient -> setCode( "RpcTypedAnswerIsNotValid" );
+    }
+    return aClient;
+}
@@ -5,6 +5,9 @@
 #include <fcntl.h>
 #include <vector>
 #include <cstring>
+#include <climits>
+#include <atomic>
+#include <sys/sendfile.h>
 
 #include "sock.h"
 #include "../core/heap.h"
@@ -14,6 +17,11 @@
 
 
 
+/* Count of own connections for unique ids of handles */
+static atomic <unsigned long long> ownConnectionCount { 0 };
+
+
+
 /*
     Constructor
 */
@@ -59,6 +67,26 @@ Sock::~Sock()
         handles -> destroy();
     }
     deleteBuffer();
+
+    /* Destroy read buffers of connections */
+    for( auto& connection : connections )
+    {
+        if( connection.buffer != NULL )
+        {
+            connection.buffer -> destroy();
+        }
+    }
+    if( clientConnection.buffer != NULL )
+    {
+        clientConnection.buffer -> destroy();
+    }
+
+    /* Close wake up pipe */
+    if( wake[ 0 ] != -1 )
+    {
+        close( wake[ 0 ] );
+        close( wake[ 1 ] );
+    }
 }
 
 
@@ -213,6 +241,13 @@ Sock* Sock::listen()
             }
         }
 
+        /* Pipe for waking the listen loop up from other threads */
+        if( isOk() && wake[ 0 ] == -1 && pipe( wake ) == 0 )
+        {
+            fcntl( wake[ 0 ], F_SETFL, O_NONBLOCK );
+            fcntl( wake[ 1 ], F_SETFL, O_NONBLOCK );
+        }
+
         listening = true;
         while( isOk() && listening )
         {
@@ -224,8 +259,15 @@ Sock* Sock::listen()
             /* Define max handle */
             int maxHandle = handle;
 
+            /* Add wake up pipe */
+            if( wake[ 0 ] != -1 )
+            {
+                FD_SET( wake[ 0 ], &readset );
+                maxHandle = max( maxHandle, wake[ 0 ] );
+            }
+
             /* Add clients handles to structure */
-            for( auto connection : connections )
+            for( auto& connection : connections )
             {
                 FD_SET( connection.handle, &readset );
                 maxHandle = max( maxHandle, connection.handle );
@@ -253,6 +295,13 @@ Sock* Sock::listen()
                 break;
             }
 
+            /* Drain wake up signals */
+            if( selectResult > 0 && wake[ 0 ] != -1 && FD_ISSET( wake[ 0 ], &readset ))
+            {
+                char signals[ 64 ];
+                while( read( wake[ 0 ], signals, sizeof( signals )) > 0 );
+            }
+
             /* Check servers handle in structure */
             if( isOk() && FD_ISSET( handle, &readset ))
             {
@@ -286,6 +335,7 @@ Sock* Sock::listen()
                             )
                         }
                     );
+                    connections.back().serial = ++lastSerial;
                 }
             }
 
@@ -294,21 +344,31 @@ Sock* Sock::listen()
             {
                 for( long unsigned int i = 0; i < connections.size(); i++ )
                 {
-                    auto connection = connections[ i ];
+                    auto& connection = connections[ i ];
                     if( FD_ISSET( connection.handle, &readset ))
                     {
                         /* Client data read */
                         if
                         (
-                            !readInternal( connection.handle, connection.address )
+                            !readInternal( connection )
                         )
                         {
                             close( connection.handle );
+                            if( connection.buffer != NULL )
+                            {
+                                connection.buffer -> destroy();
+                            }
                             connections.erase( connections.begin() + i );
                         }
                     }
                 }
             }
+
+            /* Work of the listen loop */
+            if( isOk() )
+            {
+                onListenLoop();
+            }
         }
         listening = false;
 
@@ -427,6 +487,8 @@ Sock* Sock::connect()
 */
 Sock* Sock::disconnect()
 {
+    /* Bytes of the old connection are not a frame begin for the new one */
+    clientConnection.carry.clear();
     handles -> closeHandlesByThread( id );
     return this;
 }
@@ -448,6 +510,26 @@ Sock* Sock::write
         {
             setCode( "SocketIsNotConnectedForWrite" );
         }
+        else if( aHandle != -1 && aHandle == gatherHandle )
+        {
+            /* Answer waits for the end of the read cycle */
+            if( gathered.size() + aSize > WRITE_GATHER_SIZE )
+            {
+                flushGathered();
+            }
+
+            if( aSize > WRITE_GATHER_SIZE )
+            {
+                gatherHandle = -1;
+                write( aBuffer, aSize, aHandle );
+                gatherHandle = aHandle;
+            }
+            else
+            {
+                auto buffer = ( const char* ) aBuffer;
+                gathered.insert( gathered.end(), buffer, buffer + aSize );
+            }
+        }
         else
         {
             auto sended = send
@@ -475,6 +557,223 @@ Sock* Sock::write
 
 
 
+/*
+    Write list of buffers to socket without joining them
+*/
+Sock* Sock::writeParts
+(
+    const iovec*    aParts,     /* Parts */
+    size_t          aCount,     /* Count of parts */
+    int             aHandle     /* Handle for writing */
+)
+{
+    size_t size = 0;
+    for( size_t i = 0; i < aCount; i++ )
+    {
+        size += aParts[ i ].iov_len;
+    }
+
+    if( isOk() )
+    {
+        if( !isConnected() )
+        {
+            setCode( "SocketIsNotConnectedForWrite" );
+        }
+        else if
+        (
+            aHandle != -1 &&
+            aHandle == gatherHandle &&
+            size <= WRITE_GATHER_SIZE
+        )
+        {
+            /* Parts wait for the end of the read cycle */
+            if( gathered.size() + size > WRITE_GATHER_SIZE )
+            {
+                flushGathered();
+            }
+            for( size_t i = 0; i < aCount; i++ )
+            {
+                auto buffer = ( const char* ) aParts[ i ].iov_base;
+                gathered.insert
+                (
+                    gathered.end(),
+                    buffer,
+                    buffer + aParts[ i ].iov_len
+                );
+            }
+        }
+        else
+        {
+            /* Gathered answers go before the parts */
+            if( aHandle != -1 && aHandle == gatherHandle )
+            {
+                flushGathered();
+            }
+
+            /*
+                Kernel takes at most IOV_MAX parts by one call.
+                Short write is resumed from the first unsent byte, so
+                the next parts never go before the rest of the previous.
+                Parts are copied only for the resume.
+            */
+            auto parts = ( iovec* ) aParts;
+            vector <iovec> rest;
+            size_t first = 0;
+            size_t sended = 0;
+            bool failed = false;
+            while( first < aCount && !failed )
+            {
+                msghdr message = {};
+                message.msg_iov = &parts[ first ];
+                message.msg_iovlen = min( aCount - first, ( size_t ) IOV_MAX );
+                auto count = sendmsg
+                (
+                    aHandle == -1 ? handle : aHandle,
+                    &message,
+                    MSG_NOSIGNAL    /* Prevent SIGPIPE */
+                );
+
+                if( count < 0 || ( count == 0 && sended < size ))
+                {
+                    failed = true;
+                }
+                else
+                {
+                    sended += count;
+
+                    /* Skip sent parts */
+                    size_t skip = count;
+                    while( first < aCount && skip >= parts[ first ].iov_len )
+                    {
+                        skip -= parts[ first ].iov_len;
+                        first++;
+                    }
+
+                    /* Skip sent head of the part */
+                    if( skip > 0 )
+                    {
+                        if( rest.empty() )
+                        {
+                            rest.assign( aParts, aParts + aCount );
+                            parts = rest.data();
+                        }
+                        parts[ first ].iov_base = ( char* ) parts[ first ].iov_base + skip;
+                        parts[ first ].iov_len -= skip;
+                    }
+                }
+            }
+
+            if( failed || sended != size )
+            {
+                auto error = Result::create( "SocketWriteError" );
+                error -> getDetails()
+                -> setInt( "size", size )
+                -> setInt( "sended", sended );
+                onWriteError( error );
+                error -> destroy();
+            }
+        }
+    }
+
+    return this;
+}
+
+
+
+/*
+    Send gathered answers of the connection
+    Memory of the gather buffer is kept for the next cycle
+*/
+Sock* Sock::flushGathered()
+{
+    if( !gathered.empty() )
+    {
+        auto gatheredHandle = gatherHandle;
+        gatherHandle = -1;
+        write( gathered.data(), gathered.size(), gatheredHandle );
+        gatherHandle = gatheredHandle;
+        gathered.clear();
+    }
+    return this;
+}
+
+
+
+/*
+    Write part of file to socket without copy to user space
+*/
+Sock* Sock::sendFile
+(
+    int     aFileHandle,    /* File handle, memfd for example */
+    off_t   aOffset,        /* Offset in file */
+    size_t  aSize,          /* Count of bytes */
+    int     aHandle         /* Handle for writing */
+)
+{
+    if( isOk() )
+    {
+        if( !isConnected() )
+        {
+            setCode( "SocketIsNotConnectedForWrite" );
+        }
+        else
+        {
+            /* Gathered answers go before the file */
+            if( aHandle != -1 && aHandle == gatherHandle )
+            {
+                flushGathered();
+            }
+
+            size_t sended = 0;
+            long long writeMoment = now();
+            bool sending = true;
+
+            while( sending && sended < aSize )
+            {
+                auto count = sendfile
+                (
+                    aHandle == -1 ? handle : aHandle,
+                    aFileHandle,
+                    &aOffset,
+                    aSize - sended
+                );
+
+                if( count > 0 )
+                {
+                    sended += count;
+                    writeMoment = now();
+                }
+                else
+                {
+                    /* Nonblock socket is full, waiting */
+                    sending =
+                    count < 0 &&
+                    ( errno == EAGAIN || errno == EINTR ) &&
+                    now() - writeMoment < ( long long ) readWaitingTimeoutMcs;
+                    if( sending )
+                    {
+                        usleep( PACKET_WAITING_TIMEOUT_MCS );
+                    }
+                }
+            }
+
+            if( sended != aSize )
+            {
+                auto error = Result::create( "SocketSendFileError" );
+                error -> getDetails()
+                -> setInt( "size", aSize )
+                -> setInt( "sended", sended );
+                onWriteError( error );
+                error -> destroy();
+            }
+        }
+    }
+
+    return this;
+}
+
+
+
 /*
     Write string
 */
@@ -524,9 +823,51 @@ Sock* Sock::clientRead()
     /* Check servers handle in structure */
     if( isOk() && FD_ISSET( handle, &readset ))
     {
-        readInternal( handle );
+        clientConnection.handle = handle;
+        if( !readInternal( clientConnection ))
+        {
+            /* Stream of the connection is broken */
+            disconnect();
+        }
+    }
+
+    return this;
+}
+
+
+
+/*
+    Read ready socket without waiting
+*/
+Sock* Sock::clientReadReady()
+{
+    if( isOk() )
+    {
+        clientConnection.handle = handle;
+        clientConnection.park = true;
+        auto result = readInternal( clientConnection );
+        clientConnection.park = false;
+        if( !result )
+        {
+            /* Stream of the connection is broken */
+            disconnect();
+        }
     }
+    return this;
+}
 
+
+
+/*
+    Use own connection instead of the shared one
+*/
+Sock* Sock::setOwnConnection()
+{
+    /*
+        Mask of closeHandlesByThread is a substring search,
+        so the shared id must not be a part of the own one
+    */
+    id = "#" + to_string( ++ownConnectionCount ) + "@" + getId();
     return this;
 }
 
@@ -537,24 +878,42 @@ Sock* Sock::clientRead()
 */
 bool Sock::readInternal
 (
-    int aHandle,    /* request handle */
-    string aIp      /* remote ip address */
+    Сonnections& aConnection    /* connection */
 )
 {
     bool result = true;
 
-    if( isOk() )
+    /* Answers to frames of one read cycle are sent together */
+    gatherHandle = aConnection.handle;
+
+    /* Each frame of the connection, the next one may wait in carry */
+    bool frame = isOk();
+
+    while( frame )
     {
-        /* Create error */
-        auto error = Result::create();
-        /* Create buffer */
-        auto buffer = SockBuffer::create();
+        auto aHandle = aConnection.handle;
+
+        /* Error is created only on failure */
+        Result* error = NULL;
+
+        /* Partial frame is parked in carry till the next read */
+        bool parked = false;
+
+        /* Buffer of the connection is reused between messages */
+        if( aConnection.buffer == NULL )
+        {
+            aConnection.buffer = SockBuffer::create( arena );
+        }
+        auto buffer = aConnection.buffer;
+        auto allocations = buffer -> getOwnAllocationCount();
+
+        frame = onReadBefore( aConnection.address );
 
-        if( onReadBefore( aIp ))
+        if( frame )
         {
             if( !isConnected() )
             {
-                error -> setResult( "no_connected" );
+                error = Result::create( "no_connected" );
             }
             else
             {
@@ -562,16 +921,93 @@ bool Sock::readInternal
                 bool read = true;
                 long long readMoment = now();
 
+                /* Begin of the message from the previous recv */
+                if( !aConnection.carry.empty() )
+                {
+                    auto size = aConnection.carry.size();
+                    if( holdSize( aConnection, size ))
+                    {
+                        auto item = buffer -> add( size );
+                        memcpy( item -> getPointer(), aConnection.carry.data(), size );
+                        item -> setReadSize( size );
+                        aConnection.carry.clear();
+                        read = onRead( buffer );
+                    }
+                    else
+                    {
+                        /* Frame can not be continued, drop the connection */
+                        error = Result::create( "socket_read_over_budget" );
+                        error
+                        -> getDetails()
+                        -> setInt( "heldSize", aConnection.heldSize )
+                        -> setInt( "carrySize", size )
+                        -> setInt( "connectionBudget", connectionBudget )
+                        ;
+                        result = false;
+                        read = false;
+                    }
+                }
+
                 while( read )
                 {
-                    auto item = buffer -> add( packetSize );
+                    /* Reject message over budget as soon as its size is known */
+                    auto expected = buffer -> getExpectedSize();
+                    if
+                    (
+                        expected > aConnection.heldSize &&
+                        (
+                            ( connectionBudget > 0 && expected > connectionBudget ) ||
+                            (
+                                budget != NULL &&
+                                expected - aConnection.heldSize > budget -> getFreeSize()
+                            )
+                        )
+                    )
+                    {
+                        error = Result::create( "socket_read_over_budget" );
+                        error
+                        -> getDetails()
+                        -> setInt( "expectedSize", expected )
+                        -> setInt( "connectionBudget", connectionBudget )
+                        ;
+                        /* Drop connection of the misbehaving peer */
+                        result = false;
+                        break;
+                    }
+
+                    /* Oversized message continues in memfd store */
+                    if
+                    (
+                        spillThreshold > 0 &&
+                        expected > spillThreshold &&
+                        !buffer -> isSpilled()
+                    )
+                    {
+                        buffer -> spill( expected );
+                    }
+
+                    auto size = calcPacketSize( aConnection, buffer );
+                    if( !holdSize( aConnection, size ))
+                    {
+                        error = Result::create( "socket_read_over_budget" );
+                        error
+                        -> getDetails()
+                        -> setInt( "heldSize", aConnection.heldSize )
+                        -> setInt( "packetSize", size )
+                        -> setInt( "connectionBudget", connectionBudget )
+                        ;
+                        result = false;
+                        break;
+                    }
+
+                    auto item = buffer -> add( size );
                     int bytesRead = 0;
 
                     bytesRead = recv
                     (
                         aHandle,
                         item -> getPointer(),
-                        packetSize,
+                        min( size, item -> getRealSize() ),
                         0
                     );
 
@@ -582,17 +1018,30 @@ bool Sock::readInternal
                             /* Error */
                             read = errno == EAGAIN || errno == EINTR;
 
-                            if( read )
+                            if( read && errno == EAGAIN && aConnection.park )
+                            {
+                                /* Caller reads other sockets meanwhile */
+                                buffer -> cut( 0, aConnection.carry );
+                                parked = true;
+                                read = false;
+                            }
+                            else if( read )
                             {
                                 usleep( PACKET_WAITING_TIMEOUT_MCS );
                                 auto waitingTime = now() - readMoment;
                                 read = waitingTime < readWaitingTimeoutMcs;
                                 if( !read )
                                 {
+                                    /*
+                                        Rest of the partial frame may come later,
+                                        it is not a frame begin, so the connection
+                                        is dropped
+                                    */
+                                    result = buffer -> calcReadSize() == 0;
+                                    error = Result::create( "socket_read_waiting_error" );
                                     error
-                                    -> setCode( "socket_read_waiting_error" )
                                     -> getDetails()
-                                    -> setInt( "packetSize", packetSize )
+                                    -> setInt( "packetSize", size )
                                     -> setInt( "readWaitingTimeoutMcs", readWaitingTimeoutMcs )
                                     -> setInt( "waitingTimeMcs", waitingTime )
                                     ;
@@ -600,6 +1049,7 @@ bool Sock::readInternal
                             }
                             else
                             {
+                                error = Result::create();
                                 error -> setResult
                                 (
                                     "socket_read_error",
@@ -611,8 +1061,10 @@ bool Sock::readInternal
                          }
                         case 0:
                         {
-                            /* Read zero */
+                            /* Read zero, connection is closed by peer */
+                            item -> setReadSize( 0 );
                             read = false;
+                            break;
                         }
                         default:
                         {
@@ -624,61 +1076,207 @@ bool Sock::readInternal
                     }
                 }
 
-                if( error -> isOk() )
+                if( error == NULL && !parked )
                 {
+                    /* Bytes after the message belong to the next frame */
+                    auto expected = buffer -> getExpectedSize();
+                    if( expected > 0 && buffer -> calcReadSize() > expected )
+                    {
+                        buffer -> cut( expected, aConnection.carry );
+                    }
+
+                    /* Learn message size for adaptive packet size */
+                    aConnection.sizes.add( buffer -> calcReadSize() );
+                    aConnection.sizeHint = 0;
+
                     /* Finall call onReadAfter */
                     result = onReadAfter( buffer, aHandle );
                 }
-
-                /* Destroy buffer */
             }
         }
 
-        if( !error -> isOk() )
+        if( error != NULL )
         {
             onReadError( error, buffer );
+            error -> destroy();
         }
 
-        buffer -> destroy();
-        error -> destroy();
+        /* Keep memory of buffer for the next message */
+        buffer -> reset();
+
+        /* The first message of the connection warms the buffer up */
+        if( aConnection.sizes.count > 1 )
+        {
+            readAllocationCount += buffer -> getOwnAllocationCount() - allocations;
+        }
+
+        /* Message buffers are free */
+        releaseSize( aConnection, aConnection.heldSize );
+
+        /* The next frame is parsed right away */
+        frame =
+        frame &&
+        !parked &&
+        result &&
+        error == NULL &&
+        isOk() &&
+        !aConnection.carry.empty();
+
+        if( !result || error != NULL )
+        {
+            /* Connection is broken, rest of bytes is not valid */
+            aConnection.carry.clear();
+        }
     }
 
+    flushGathered();
+    gatherHandle = -1;
+
     return result;
 }
 
 
 
 /*
-    Convert string to numeric IP address
+    Return size for the next recv of the message
+    In fixed mode it is packetSize.
+    In adaptive mode it is the rest of the message when the protocol knows
+    the expected size, otherwise the hint or the average message size
+    of the connection. The result is limited by bounds.
 */
-unsigned int Sock::stringToIp
+unsigned int Sock::calcPacketSize
 (
-    string aString
+    Сonnections&    aConnection,    /* connection */
+    SockBuffer*     aBuffer         /* reading buffer */
 )
 {
-    int a, b, c, d;
-    char arr[4];
-
-    sscanf( aString.c_str(), "%d.%d.%d.%d", &a, &b, &c, &d );
+    unsigned int result = packetSize;
 
-    arr[0] = a;
-    arr[1] = b;
-    arr[2] = c;
-    arr[3] = d;
+    if( packetSizeMode == PSM_ADAPTIVE )
+    {
+        auto expected = aBuffer -> getExpectedSize();
+        auto readed = aBuffer -> calcReadSize();
+        if( expected > readed )
+        {
+            /* Rest of message, never read beyond the message end */
+            result = min( expected - readed, ( size_t ) packetSizeMax );
+        }
+        else
+        {
+            if( aConnection.sizeHint > 0 )
+            {
+                result = aConnection.sizeHint;
+            }
+            else if( aConnection.sizes.count > 0 )
+            {
+                result = aConnection.sizes.average;
+            }
+            result = max( packetSizeMin, min( result, packetSizeMax ));
+        }
+    }
 
-    return *( unsigned int *) arr;
+    return result;
 }
 
 
 
-string Sock::ipToString
+/*
+    Hold bytes of the connection in budgets
+    Return false when connection or global budget is exceeded
+*/
+bool Sock::holdSize
 (
-    unsigned int a
+    Сonnections&    aConnection,    /* connection */
+    size_t          aSize           /* bytes */
 )
 {
-    auto ip = ( unsigned char* )&a;
-    return
-    to_string( ip[ 0 ] ) + "." +
+    bool result =
+    connectionBudget == 0 ||
+    aConnection.heldSize + aSize <= connectionBudget;
+
+    if( result && budget != NULL )
+    {
+        result = budget -> reserve( aSize );
+    }
+
+    if( result )
+    {
+        aConnection.heldSize += aSize;
+    }
+
+    return result;
+}
+
+
+
+/*
+    Release bytes of the connection in budgets
+*/
+Sock* Sock::releaseSize
+(
+    Сonnections&    aConnection,    /* connection */
+    size_t          aSize           /* bytes */
+)
+{
+    if( budget != NULL )
+    {
+        budget -> release( aSize );
+    }
+    aConnection.heldSize -= aSize;
+    return this;
+}
+
+
+
+/*
+    Add message size to statistics
+    Average is exponential with 1/8 weight for the new size
+*/
+SockSizeStat* SockSizeStat::add
+(
+    unsigned int aSize
+)
+{
+    average = count == 0 ? aSize : ( average * 7ull + aSize ) / 8;
+    max = std::max( max, aSize );
+    total += aSize;
+    count++;
+    return this;
+}
+
+
+
+/*
+    Convert string to numeric IP address
+*/
+unsigned int Sock::stringToIp
+(
+    string aString
+)
+{
+    int a, b, c, d;
+    char arr[4];
+
+    sscanf( aString.c_str(), "%d.%d.%d.%d", &a, &b, &c, &d );
+
+    arr[0] = a;
+    arr[1] = b;
+    arr[2] = c;
+    arr[3] = d;
+
+    return *( unsigned int *) arr;
+}
+
+
+
+string Sock::ipToString
+(
+    unsigned int a
+)
+{
+    auto ip = ( unsigned char* )&a;
+    return
+    to_string( ip[ 0 ] ) + "." +
     to_string( ip[ 1 ] ) + "." +
     to_string( ip[ 2 ] ) + "." +
     to_string( ip[ 3 ] );
@@ -729,6 +1327,272 @@ unsigned int Sock::getPacketSize()
 
 
 
+/*
+    Set packet size mode
+*/
+Sock* Sock::setPacketSizeMode
+(
+    PacketSizeMode a
+)
+{
+    packetSizeMode = a;
+    return this;
+}
+
+
+
+/*
+    Return packet size mode
+*/
+PacketSizeMode Sock::getPacketSizeMode()
+{
+    return packetSizeMode;
+}
+
+
+
+/*
+    Set bounds of adaptive packet size
+*/
+Sock* Sock::setPacketSizeLimits
+(
+    unsigned int aMin,  /* Minimum */
+    unsigned int aMax   /* Maximum */
+)
+{
+    packetSizeMin = max( 1u, aMin );
+    packetSizeMax = max( packetSizeMin, aMax );
+    return this;
+}
+
+
+
+/*
+    Return minimum adaptive packet size
+*/
+unsigned int Sock::getPacketSizeMin()
+{
+    return packetSizeMin;
+}
+
+
+
+/*
+    Return maximum adaptive packet size
+*/
+unsigned int Sock::getPacketSizeMax()
+{
+    return packetSizeMax;
+}
+
+
+
+/*
+    Set expected size of the next message for clientRead
+*/
+Sock* Sock::setPacketSizeHint
+(
+    unsigned int a
+)
+{
+    clientConnection.sizeHint = a;
+    return this;
+}
+
+
+
+/*
+    Return message size statistics of the client connection
+*/
+SockSizeStat Sock::getClientSizes()
+{
+    return clientConnection.sizes;
+}
+
+
+
+/*
+    Set arena for receive and send buffers
+*/
+Sock* Sock::setArena
+(
+    SockArena* a
+)
+{
+    arena = a;
+    return this;
+}
+
+
+
+/*
+    Return arena for buffers or NULL
+*/
+SockArena* Sock::getArena()
+{
+    return arena;
+}
+
+
+
+/*
+    Set global budget for buffers
+*/
+Sock* Sock::setBudget
+(
+    SockBudget* a
+)
+{
+    budget = a;
+    return this;
+}
+
+
+
+/*
+    Return global budget for buffers or NULL
+*/
+SockBudget* Sock::getBudget()
+{
+    return budget;
+}
+
+
+
+/*
+    Set budget of bytes for one connection, 0 is unlimited
+*/
+Sock* Sock::setConnectionBudget
+(
+    size_t a
+)
+{
+    connectionBudget = a;
+    return this;
+}
+
+
+
+/*
+    Return budget of bytes for one connection
+*/
+size_t Sock::getConnectionBudget()
+{
+    return connectionBudget;
+}
+
+
+
+/*
+    Reserve bytes for writing
+*/
+bool Sock::reserveBudget
+(
+    size_t aSize
+)
+{
+    bool result = connectionBudget == 0 || aSize <= connectionBudget;
+
+    if( result && budget != NULL )
+    {
+        result = budget -> reserve( aSize );
+    }
+
+    if( result )
+    {
+        writeHeldSize += aSize;
+    }
+
+    return result;
+}
+
+
+
+/*
+    Release bytes reserved for writing
+*/
+Sock* Sock::releaseBudget
+(
+    size_t aSize
+)
+{
+    if( budget != NULL )
+    {
+        budget -> release( aSize );
+    }
+    writeHeldSize -= aSize;
+    return this;
+}
+
+
+
+/*
+    Return bytes held by all connections of the sock
+*/
+size_t Sock::getHeldSize()
+{
+    size_t result = clientConnection.heldSize + writeHeldSize;
+    for( auto& connection : connections )
+    {
+        result += connection.heldSize;
+    }
+    return result;
+}
+
+
+
+/*
+    Return bytes held by the connection
+*/
+size_t Sock::getHeldSize
+(
+    int aHandle /* Handle of connection */
+)
+{
+    size_t result = 0;
+    if( aHandle == clientConnection.handle )
+    {
+        result = clientConnection.heldSize;
+    }
+    else
+    {
+        for( auto& connection : connections )
+        {
+            if( connection.handle == aHandle )
+            {
+                result = connection.heldSize;
+            }
+        }
+    }
+    return result;
+}
+
+
+
+/*
+    Set size of message for memfd store, 0 disables store
+*/
+Sock* Sock::setSpillThreshold
+(
+    size_t a
+)
+{
+    spillThreshold = a;
+    return this;
+}
+
+
+
+/*
+    Return size of message for memfd store
+*/
+size_t Sock::getSpillThreshold()
+{
+    return spillThreshold;
+}
+
+
+
 /*
     Set read timeout
 */
@@ -915,6 +1779,17 @@ Sock* Sock::onListenAfter
 
 
 
+/*
+    On listen loop iteration
+    Method may be overrided
+*/
+Sock* Sock::onListenLoop()
+{
+    return this;
+}
+
+
+
 /*
     On read error
 */
@@ -948,3 +1823,59 @@ string Sock::getId()
 {
     return ip + ":" + to_string( port );
 }
+
+
+
+/*
+    Wake the listen loop up
+*/
+Sock* Sock::wakeUp()
+{
+    if( wake[ 1 ] != -1 )
+    {
+        auto sended = ::write( wake[ 1 ], "w", 1 );
+        ( void ) sended;
+    }
+    return this;
+}
+
+
+
+/*
+    Return count of buffer allocations by messages after the first one
+*/
+unsigned long long Sock::getReadAllocationCount()
+{
+    return readAllocationCount;
+}
+
+
+
+/*
+    Return serial of the connection by handle or 0
+*/
+unsigned long long Sock::getConnectionSerial
+(
+    int aHandle /* Handle of connection */
+)
+{
+    unsigned long long result = 0;
+    for( auto& connection : connections )
+    {
+        if( connection.handle == aHandle )
+        {
+            result = connection.serial;
+        }
+    }
+    return result;
+}
+
+
+
+/*
+    Return handle of the socket or -1
+*/
+int Sock::getHandle()
+{
+    return handle;
+}
@@ -8,11 +8,13 @@
 #include <vector>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include "../core/result.h"
 
 #include "sock_buffer.h"
 #include "sock_manager.h"
+#include "sock_budget.h"
 
 
 /* Predeclaration sock for events definitions */
@@ -22,6 +24,9 @@ class Sock;
 
 #define PACKET_WAITING_TIMEOUT_MCS 2000
 #define READ_WAITING_TIMEOUT_MCS 500000
+#define PACKET_SIZE_MIN 64
+#define PACKET_SIZE_MAX 1048576
+#define WRITE_GATHER_SIZE 65536
 
 
 enum SocketDomain
@@ -43,13 +48,52 @@ enum SocketType
 
 
 
+/*
+    Packet size modes
+*/
+enum PacketSizeMode
+{
+    PSM_FIXED,      /* Each recv uses packetSize */
+    PSM_ADAPTIVE    /* Recv size learns from message sizes */
+};
+
+
+
+/*
+    Message size statistics for adaptive packet size
+*/
+struct SockSizeStat
+{
+    unsigned long long  count   = 0;    /* count of messages */
+    unsigned long long  total   = 0;    /* total bytes of messages */
+    unsigned int        average = 0;    /* moving average of message size */
+    unsigned int        max     = 0;    /* maximum message size */
+
+    /*
+        Add message size to statistics
+    */
+    SockSizeStat* add
+    (
+        unsigned int    /* Message size */
+    );
+};
+
+
+
 /*
     Cliients connections for server
 */
 struct Сonnections
 {
-    int     handle = 0;     /* client connection handle after accept */
-    string  address = "";   /* client ip address */
+    int             handle = 0;     /* client connection handle after accept */
+    string          address = "";   /* client ip address */
+    SockSizeStat    sizes;          /* message sizes for adaptive packet size */
+    unsigned int    sizeHint = 0;   /* expected size of the next message */
+    size_t          heldSize = 0;   /* bytes held by buffers of connection */
+    SockBuffer*     buffer = NULL;  /* read buffer reused between messages */
+    vector <char>   carry;          /* bytes of the next frame after message */
+    unsigned long long serial = 0;  /* number of connection for the sock */
+    bool            park = false;   /* partial frame goes to carry instead of waiting */
 };
 
 
@@ -69,14 +113,28 @@ class Sock : public Result
         bool                privateSockManager  = false;
         int                 handle              = -1;       /* Handle after openHandle method */
         SockManager*        handles             = NULL;     /* handles */
+        SockArena*          arena               = NULL;     /* Memory for buffers or NULL for heap */
+        SockBudget*         budget              = NULL;     /* Global budget of buffers or NULL */
+        size_t              connectionBudget    = 0;        /* Bytes for one connection, 0 is unlimited */
+        size_t              writeHeldSize       = 0;        /* Bytes reserved for writing */
+        size_t              spillThreshold      = 0;        /* Message size for memfd store, 0 is off */
+        unsigned long long  readAllocationCount = 0;        /* Buffer allocations of steady reads */
         unsigned int        queueSize           = 50;       /* Resuest queue size */
         unsigned int        packetSize          = 1024;     /* Data packet size */
+        PacketSizeMode      packetSizeMode      = PSM_FIXED;
+        unsigned int        packetSizeMin       = PACKET_SIZE_MIN;
+        unsigned int        packetSizeMax       = PACKET_SIZE_MAX;
+        Сonnections         clientConnection;               /* Connection state for clientRead */
         char*               resultBuffer        = NULL;
         unsigned int        resultBufferSize    = 0;
         string              remoteAddress       = "";
         string              id                  = "";       /* Socket id for handles */
 
         bool                listening           = false;
+        int                 wake[ 2 ]           = { -1, -1 };   /* Pipe for waking listen loop up */
+        unsigned long long  lastSerial          = 0;        /* Serial of the last connection */
+        int                 gatherHandle        = -1;       /* Connection with gathered answers */
+        vector <char>       gathered;                       /* Answers for one send */
 
         /*
             Arguments
@@ -98,8 +156,40 @@ class Sock : public Result
         */
         bool readInternal
         (
-            int,        /* request handle */
-            string = "" /* remote ip address */
+            Сonnections&    /* connection */
+        );
+
+
+
+        /*
+            Hold bytes of the connection in budgets
+        */
+        bool holdSize
+        (
+            Сonnections&,   /* connection */
+            size_t          /* bytes */
+        );
+
+
+
+        /*
+            Release bytes of the connection in budgets
+        */
+        Sock* releaseSize
+        (
+            Сonnections&,   /* connection */
+            size_t          /* bytes */
+        );
+
+
+
+        /*
+            Return size for the next recv of the message
+        */
+        unsigned int calcPacketSize
+        (
+            Сonnections&,   /* connection */
+            SockBuffer*     /* reading buffer */
         );
 
 
@@ -206,6 +296,41 @@ class Sock : public Result
 
 
 
+    /*
+        Write list of buffers to socket without joining them
+        Parts go to the gather buffer of the read cycle or to one
+        sendmsg, so header and payload need no common buffer
+    */
+    Sock* writeParts
+    (
+        const iovec*,   /* Parts */
+        size_t,         /* Count of parts */
+        int = -1        /* Handle for writing */
+    );
+
+
+
+    /*
+        Send answers gathered in the read cycle right now
+    */
+    Sock* flushGathered();
+
+
+
+    /*
+        Write part of file to socket with sendfile
+        Used for memfd store of SockBuffer without copy
+    */
+    Sock* sendFile
+    (
+        int,            /* File handle */
+        off_t,          /* Offset in file */
+        size_t,         /* Count of bytes */
+        int = -1        /* Handle for writing */
+    );
+
+
+
     /*
         Write string to socket
     */
@@ -227,6 +352,24 @@ class Sock : public Result
 
 
 
+    /*
+        Read ready socket without waiting
+        Partial frame is kept in the connection till the next call,
+        so one thread may read many sockets by own select
+    */
+    Sock* clientReadReady();
+
+
+
+    /*
+        Use own connection instead of the shared one
+        Sockets of one thread with the same ip and port share the
+        handle of SockManager. Call it before connect.
+    */
+    Sock* setOwnConnection();
+
+
+
     /*
         Convert string to numeric IP address
     */
@@ -261,6 +404,68 @@ class Sock : public Result
     unsigned int getPacketSize();
 
 
+
+    /*
+        Set packet size mode
+        PSM_FIXED uses packetSize for each recv
+        PSM_ADAPTIVE picks recv size from message sizes in bounds
+    */
+    Sock* setPacketSizeMode
+    (
+        PacketSizeMode
+    );
+
+
+
+    /*
+        Return packet size mode
+    */
+    PacketSizeMode getPacketSizeMode();
+
+
+
+    /*
+        Set bounds of adaptive packet size
+    */
+    Sock* setPacketSizeLimits
+    (
+        unsigned int,   /* Minimum */
+        unsigned int    /* Maximum */
+    );
+
+
+
+    /*
+        Return minimum adaptive packet size
+    */
+    unsigned int getPacketSizeMin();
+
+
+
+    /*
+        Return maximum adaptive packet size
+    */
+    unsigned int getPacketSizeMax();
+
+
+
+    /*
+        Set expected size of the next message for clientRead
+        Used in adaptive mode when caller knows better than statistics
+    */
+    Sock* setPacketSizeHint
+    (
+        unsigned int
+    );
+
+
+
+    /*
+        Return message size statistics of the client connection
+    */
+    SockSizeStat getClientSizes();
+
+
     Sock* deleteBuffer();
 
 
@@ -293,6 +498,154 @@ class Sock : public Result
 
 
 
+    /*
+        Return handle of the socket or -1
+    */
+    int getHandle();
+
+
+
+    /*
+        Wake the listen loop up
+        Thread safe, onListenLoop will be called without select waiting
+    */
+    Sock* wakeUp();
+
+
+
+    /*
+        Return count of buffer allocations by messages after the first
+        one of each connection
+        Steady read of messages of similar size keeps it 0, tests and
+        benchmarks check it after a series of messages
+    */
+    unsigned long long getReadAllocationCount();
+
+
+
+    /*
+        Return serial of the connection by handle or 0
+        Handles are reused by system, serial identifies the connection
+    */
+    unsigned long long getConnectionSerial
+    (
+        int /* Handle of connection */
+    );
+
+
+
+    /*
+        Set arena for receive and send buffers
+        Arena is not owned by Sock, NULL returns buffers to heap
+    */
+    Sock* setArena
+    (
+        SockArena*
+    );
+
+
+
+    /*
+        Return arena for buffers or NULL
+    */
+    SockArena* getArena();
+
+
+
+    /*
+        Set global budget for buffers
+        Budget is not owned by Sock and may be shared between socks
+    */
+    Sock* setBudget
+    (
+        SockBudget*
+    );
+
+
+
+    /*
+        Return global budget for buffers or NULL
+    */
+    SockBudget* getBudget();
+
+
+
+    /*
+        Set budget of bytes for one connection, 0 is unlimited
+        Messages declaring a bigger size are rejected and the connection
+        is closed
+    */
+    Sock* setConnectionBudget
+    (
+        size_t
+    );
+
+
+
+    /*
+        Return budget of bytes for one connection
+    */
+    size_t getConnectionBudget();
+
+
+
+    /*
+        Reserve bytes for writing
+        Return false when the message does not fit to budgets
+    */
+    bool reserveBudget
+    (
+        size_t
+    );
+
+
+
+    /*
+        Release bytes reserved for writing
+    */
+    Sock* releaseBudget
+    (
+        size_t
+    );
+
+
+
+    /*
+        Return bytes held by all connections of the sock
+    */
+    size_t getHeldSize();
+
+
+
+    /*
+        Return bytes held by the connection
+    */
+    size_t getHeldSize
+    (
+        int /* Handle of connection */
+    );
+
+
+
+    /*
+        Set size of message for memfd store, 0 disables store
+        Messages bigger than threshold are read to memfd mapping
+        instead of heap items, see SockBuffer::spill
+    */
+    Sock* setSpillThreshold
+    (
+        size_t
+    );
+
+
+
+    /*
+        Return size of message for memfd store
+    */
+    size_t getSpillThreshold();
+
+
+
     /*
         Set read timeout
     */
@@ -403,6 +756,14 @@ class Sock : public Result
 
 
 
+    /*
+        On listen loop iteration after reading of clients
+        Method may be overrided
+    */
+    virtual Sock* onListenLoop();
+
+
+
     /*
         On read error event
     */
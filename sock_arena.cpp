@@ -0,0 +1,340 @@
+/*
+    Sys libraries
+*/
+#include <sys/mman.h>
+#include <cstdint>
+#include <algorithm>
+
+/*
+    Local libraries
+*/
+#include "sock_arena.h"
+
+
+
+/*
+    Constructor
+*/
+SockArena::SockArena
+(
+    bool aHugePages /* Use huge pages */
+)
+{
+    hugePages = aHugePages;
+}
+
+
+
+/*
+    Destructor
+*/
+SockArena::~SockArena()
+{
+    for( auto region : regions )
+    {
+        munmap( region.pointer, region.size );
+    }
+}
+
+
+
+/*
+    Create arena
+*/
+SockArena* SockArena::create
+(
+    bool aHugePages /* Use huge pages */
+)
+{
+    return new SockArena( aHugePages );
+}
+
+
+
+/*
+    Destroy arena
+*/
+void SockArena::destroy()
+{
+    delete this;
+}
+
+
+
+/*
+    Map region of memory
+    Unsafe! Call under sync only.
+*/
+char* SockArena::map
+(
+    size_t aSize    /* Size aligned to ARENA_REGION_SIZE */
+)
+{
+    SockArenaRegion region;
+    region.size = aSize;
+
+    void* pointer = MAP_FAILED;
+
+    if( hugePages )
+    {
+        /* Reserved huge pages */
+        pointer = mmap
+        (
+            NULL,
+            aSize,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+            -1,
+            0
+        );
+        region.huge = pointer != MAP_FAILED;
+    }
+
+    if( pointer == MAP_FAILED )
+    {
+        /* Usual pages aligned to huge page for transparent huge pages */
+        auto mappedSize = aSize + ARENA_REGION_SIZE;
+        auto mapped = mmap
+        (
+            NULL,
+            mappedSize,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS,
+            -1,
+            0
+        );
+
+        if( mapped != MAP_FAILED )
+        {
+            auto begin = ( uintptr_t ) mapped;
+            auto aligned =
+            ( begin + ARENA_REGION_SIZE - 1 ) & ~(( uintptr_t ) ARENA_REGION_SIZE - 1 );
+
+            /* Unmap head and tail around aligned region */
+            if( aligned > begin )
+            {
+                munmap( mapped, aligned - begin );
+            }
+            auto tail = begin + mappedSize - ( aligned + aSize );
+            if( tail > 0 )
+            {
+                munmap(( void* )( aligned + aSize ), tail );
+            }
+
+            pointer = ( void* ) aligned;
+
+            if( hugePages )
+            {
+                madvise( pointer, aSize, MADV_HUGEPAGE );
+            }
+        }
+    }
+
+    char* result = NULL;
+
+    if( pointer != MAP_FAILED )
+    {
+        result = ( char* ) pointer;
+        region.pointer = result;
+        regions.push_back( region );
+        reservedSize += aSize;
+        if( region.huge )
+        {
+            hugeSize += aSize;
+        }
+    }
+
+    return result;
+}
+
+
+
+/*
+    Return size class for size or -1 for large blocks
+*/
+int SockArena::getClass
+(
+    size_t aSize
+)
+{
+    int result = 0;
+    size_t classSize = ARENA_CLASS_MIN;
+    while( classSize < aSize && result < ARENA_CLASS_COUNT )
+    {
+        classSize <<= 1;
+        result++;
+    }
+    return result < ARENA_CLASS_COUNT ? result : -1;
+}
+
+
+
+/*
+    Return block of memory
+*/
+char* SockArena::allocate
+(
+    size_t aSize    /* Size */
+)
+{
+    char* result = NULL;
+    auto blockClass = getClass( aSize );
+
+    sync.lock();
+    {
+        if( blockClass < 0 )
+        {
+            /* Large block has own region */
+            auto size =
+            ( aSize + ARENA_REGION_SIZE - 1 ) / ARENA_REGION_SIZE * ARENA_REGION_SIZE;
+            result = map( size );
+            if( result != NULL )
+            {
+                usedSize += size;
+            }
+        }
+        else
+        {
+            size_t size = ( size_t ) ARENA_CLASS_MIN << blockClass;
+            auto& list = freeBlocks[ blockClass ];
+
+            if( !list.empty() )
+            {
+                /* Reuse free block */
+                result = list.back();
+                list.pop_back();
+            }
+            else
+            {
+                /* Cut new block from region */
+                if( regionRest < size )
+                {
+                    /* Rest of region goes to free lists of smaller classes */
+                    for
+                    (
+                        int i = ARENA_CLASS_COUNT - 1;
+                        i >= 0 && regionRest >= ARENA_CLASS_MIN;
+                        i--
+                    )
+                    {
+                        size_t restSize = ( size_t ) ARENA_CLASS_MIN << i;
+                        if( regionRest >= restSize )
+                        {
+                            freeBlocks[ i ].push_back( regionPointer );
+                            regionPointer += restSize;
+                            regionRest -= restSize;
+                        }
+                    }
+
+                    regionPointer = map( ARENA_REGION_SIZE );
+                    regionRest = regionPointer == NULL ? 0 : ARENA_REGION_SIZE;
+                }
+
+                if( regionRest >= size )
+                {
+                    result = regionPointer;
+                    regionPointer += size;
+                    regionRest -= size;
+                }
+            }
+
+            if( result != NULL )
+            {
+                usedSize += size;
+            }
+        }
+
+        peakSize = max( peakSize, usedSize );
+    }
+    sync.unlock();
+
+    return result;
+}
+
+
+
+/*
+    Return block to arena
+*/
+SockArena* SockArena::release
+(
+    char*   aBlock, /* Block */
+    size_t  aSize   /* Size */
+)
+{
+    if( aBlock != NULL )
+    {
+        auto blockClass = getClass( aSize );
+
+        sync.lock();
+        {
+            if( blockClass < 0 )
+            {
+                /* Large block unmaps own region */
+                for( auto region = regions.begin(); region != regions.end(); region++ )
+                {
+                    if( region -> pointer == aBlock )
+                    {
+                        munmap( region -> pointer, region -> size );
+                        usedSize -= region -> size;
+                        reservedSize -= region -> size;
+                        if( region -> huge )
+                        {
+                            hugeSize -= region -> size;
+                        }
+                        regions.erase( region );
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                freeBlocks[ blockClass ].push_back( aBlock );
+                usedSize -= ( size_t ) ARENA_CLASS_MIN << blockClass;
+            }
+        }
+        sync.unlock();
+    }
+
+    return this;
+}
+
+
+
+/*
+    Return count of mapped bytes
+*/
+size_t SockArena::getReservedSize()
+{
+    return reservedSize;
+}
+
+
+
+/*
+    Return count of mapped bytes on huge pages
+*/
+size_t SockArena::getHugeSize()
+{
+    return hugeSize;
+}
+
+
+
+/*
+    Return count of bytes in use
+*/
+size_t SockArena::getUsedSize()
+{
+    return usedSize;
+}
+
+
+
+/*
+    Return maximum count of bytes in use
+*/
+size_t SockArena::getPeakSize()
+{
+    return peakSize;
+}
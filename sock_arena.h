@@ -0,0 +1,171 @@
+/*
+    Memory arena for socket buffers
+    Arena can be created at main application and passed to Sock objects.
+    Memory is mapped by regions of 2 MB huge pages (MAP_HUGETLB). When huge
+    pages are not reserved in the system, regions are mapped as usual memory
+    aligned to 2 MB with transparent huge pages advice (MADV_HUGEPAGE).
+    Blocks are cut from regions by power of two size classes and returned
+    to free lists of classes, so the bulk buffers do not churn the heap.
+*/
+
+#pragma once
+
+
+
+#include <vector>
+#include <mutex>
+#include <cstddef>
+
+
+
+using namespace std;
+
+
+
+#define ARENA_REGION_SIZE   2097152     /* 2 MB huge page */
+#define ARENA_CLASS_MIN     64          /* Minimum block size */
+#define ARENA_CLASS_COUNT   15          /* 64 B ... 1 MB blocks */
+
+
+
+/*
+    Arena region
+*/
+struct SockArenaRegion
+{
+    char*   pointer = NULL;
+    size_t  size    = 0;
+    bool    huge    = false;    /* Mapped with MAP_HUGETLB */
+};
+
+
+
+class SockArena
+{
+    private:
+
+        /* Main mutex for synchronizing allocations */
+        mutex sync;
+
+        /* Use huge pages for regions */
+        bool hugePages = true;
+
+        /* Mapped regions */
+        vector <SockArenaRegion> regions;
+
+        /* Free blocks for each size class */
+        vector <char*> freeBlocks[ ARENA_CLASS_COUNT ];
+
+        /* Current region for cutting blocks */
+        char*   regionPointer   = NULL;
+        size_t  regionRest      = 0;
+
+        /* Usage */
+        size_t  reservedSize    = 0;    /* Mapped bytes */
+        size_t  hugeSize        = 0;    /* Mapped bytes with MAP_HUGETLB */
+        size_t  usedSize        = 0;    /* Bytes of blocks in use */
+        size_t  peakSize        = 0;    /* Maximum of usedSize */
+
+        /*
+            Map region of memory
+        */
+        char* map
+        (
+            size_t  /* Size aligned to ARENA_REGION_SIZE */
+        );
+
+
+
+        /*
+            Return size class for size or -1 for large blocks
+        */
+        static int getClass
+        (
+            size_t
+        );
+
+    public:
+
+        /*
+            Constructor
+        */
+        SockArena
+        (
+            bool    /* Use huge pages */
+        );
+
+
+
+        /*
+            Destructor
+        */
+        ~SockArena();
+
+
+
+        /*
+            Create arena
+        */
+        static SockArena* create
+        (
+            bool = true /* Use huge pages */
+        );
+
+
+
+        /*
+            Destroy arena
+        */
+        void destroy();
+
+
+
+        /*
+            Return block of memory
+            Return NULL if memory can not be mapped
+        */
+        char* allocate
+        (
+            size_t  /* Size */
+        );
+
+
+
+        /*
+            Return block to arena
+            Size must be the same as for allocate
+        */
+        SockArena* release
+        (
+            char*,  /* Block */
+            size_t  /* Size */
+        );
+
+
+
+        /*
+            Return count of mapped bytes
+        */
+        size_t getReservedSize();
+
+
+
+        /*
+            Return count of mapped bytes on huge pages
+        */
+        size_t getHugeSize();
+
+
+
+        /*
+            Return count of bytes in use
+        */
+        size_t getUsedSize();
+
+
+
+        /*
+            Return maximum count of bytes in use
+        */
+        size_t getPeakSize();
+};
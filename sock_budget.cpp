@@ -0,0 +1,159 @@
+#include "sock_budget.h"
+
+
+
+/*
+    Constructor
+*/
+SockBudget::SockBudget
+(
+    size_t aLimit   /* Limit */
+)
+{
+    limit = aLimit;
+}
+
+
+
+/*
+    Create budget
+*/
+SockBudget* SockBudget::create
+(
+    size_t aLimit   /* Limit of bytes, 0 is unlimited */
+)
+{
+    return new SockBudget( aLimit );
+}
+
+
+
+/*
+    Destroy budget
+*/
+void SockBudget::destroy()
+{
+    delete this;
+}
+
+
+
+/*
+    Reserve bytes
+*/
+bool SockBudget::reserve
+(
+    size_t aSize    /* Size */
+)
+{
+    auto held = heldSize.load();
+    bool result = false;
+
+    do
+    {
+        result = limit == 0 || ( aSize <= limit && held <= limit - aSize );
+    }
+    while
+    (
+        result &&
+        !heldSize.compare_exchange_weak( held, held + aSize )
+    );
+
+    if( result )
+    {
+        /* Update peak */
+        auto peak = peakSize.load();
+        while
+        (
+            held + aSize > peak &&
+            !peakSize.compare_exchange_weak( peak, held + aSize )
+        );
+    }
+    else
+    {
+        rejectedCount++;
+    }
+
+    return result;
+}
+
+
+
+/*
+    Release reserved bytes
+*/
+SockBudget* SockBudget::release
+(
+    size_t aSize    /* Size */
+)
+{
+    heldSize -= aSize;
+    return this;
+}
+
+
+
+/*
+    Set limit of bytes, 0 is unlimited
+*/
+SockBudget* SockBudget::setLimit
+(
+    size_t a
+)
+{
+    limit = a;
+    return this;
+}
+
+
+
+/*
+    Return limit of bytes
+*/
+size_t SockBudget::getLimit()
+{
+    return limit;
+}
+
+
+
+/*
+    Return count of reserved bytes
+*/
+size_t SockBudget::getHeldSize()
+{
+    return heldSize.load();
+}
+
+
+
+/*
+    Return count of bytes available for reserve
+*/
+size_t SockBudget::getFreeSize()
+{
+    auto held = heldSize.load();
+    return limit == 0
+    ? (size_t) -1
+    : ( held < limit ? limit - held : 0 );
+}
+
+
+
+/*
+    Return maximum of reserved bytes
+*/
+size_t SockBudget::getPeakSize()
+{
+    return peakSize.load();
+}
+
+
+
+/*
+    Return count of rejected reservations
+*/
+unsigned long long SockBudget::getRejectedCount()
+{
+    return rejectedCount.load();
+}
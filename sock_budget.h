@@ -0,0 +1,126 @@
+/*
+    Memory budget for socket buffers
+    Budget can be created at main application and passed to Sock objects.
+    Each sock reserves bytes of its buffers in the budget before reading or
+    writing and releases them after. Reservation over the limit is rejected,
+    so misbehaving peers can not make the process hold unlimited memory.
+*/
+
+#pragma once
+
+
+
+#include <atomic>
+#include <cstddef>
+
+
+
+using namespace std;
+
+
+
+class SockBudget
+{
+    private:
+
+        /* Limit of bytes, 0 is unlimited */
+        size_t                          limit           = 0;
+
+        /* Accounting */
+        atomic <size_t>                 heldSize        { 0 };
+        atomic <size_t>                 peakSize        { 0 };
+        atomic <unsigned long long>     rejectedCount   { 0 };
+
+    public:
+
+        /*
+            Constructor
+        */
+        SockBudget
+        (
+            size_t  /* Limit */
+        );
+
+
+
+        /*
+            Create budget
+        */
+        static SockBudget* create
+        (
+            size_t = 0  /* Limit of bytes, 0 is unlimited */
+        );
+
+
+
+        /*
+            Destroy budget
+        */
+        void destroy();
+
+
+
+        /*
+            Reserve bytes
+            Return false and reserve nothing when limit is exceeded
+        */
+        bool reserve
+        (
+            size_t  /* Size */
+        );
+
+
+
+        /*
+            Release reserved bytes
+        */
+        SockBudget* release
+        (
+            size_t  /* Size */
+        );
+
+
+
+        /*
+            Set limit of bytes, 0 is unlimited
+        */
+        SockBudget* setLimit
+        (
+            size_t
+        );
+
+
+
+        /*
+            Return limit of bytes
+        */
+        size_t getLimit();
+
+
+
+        /*
+            Return count of reserved bytes
+        */
+        size_t getHeldSize();
+
+
+
+        /*
+            Return count of bytes available for reserve
+        */
+        size_t getFreeSize();
+
+
+
+        /*
+            Return maximum of reserved bytes
+        */
+        size_t getPeakSize();
+
+
+
+        /*
+            Return count of rejected reservations
+        */
+        unsigned long long getRejectedCount();
+};
@@ -1,15 +1,26 @@
 #include <iostream>
 #include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "sock_buffer.h"
 
 
 
+/* Count of allocations for tests and benchmarks */
+static atomic <unsigned long long> allocationCount { 0 };
+
+
+
 /*
     Constructor
 */
-SockBuffer::SockBuffer()
+SockBuffer::SockBuffer
+(
+    SockArena* aArena   /* Arena or NULL for heap */
+)
 {
+    arena = aArena;
 };
 
 
@@ -28,9 +39,13 @@ SockBuffer::~SockBuffer()
 /*
     Create buffer
 */
-SockBuffer* SockBuffer::create()
+SockBuffer* SockBuffer::create
+(
+    SockArena* aArena   /* Arena or NULL for heap */
+)
 {
-    return new SockBuffer();
+    allocationCount++;
+    return new SockBuffer( aArena );
 }
 
 
@@ -51,10 +66,126 @@ void SockBuffer::destroy()
 SockBuffer* SockBuffer::clear()
 {
     for( auto item:items )
+    {
+        if( item != spillTail )
+        {
+            item -> destroy();
+        }
+    }
+    items.clear();
+    for( auto item:spare )
     {
         item -> destroy();
     }
+    spare.clear();
+    expectedSize = 0;
+    destroySpill();
+    return this;
+}
+
+
+
+/*
+    Prepare buffer for the next message
+*/
+SockBuffer* SockBuffer::reset()
+{
+    /* Items go to spare in back order, the first item is taken first */
+    size_t kept = 0;
+    for( auto item = items.rbegin(); item != items.rend(); item++ )
+    {
+        if( *item == spillTail )
+        {
+            /* Tail is destroyed with the store */
+        }
+        else if
+        (
+            !( *item ) -> isView() &&
+            kept + ( *item ) -> getRealSize() <= SOCK_BUFFER_KEEP_SIZE
+        )
+        {
+            kept += ( *item ) -> getRealSize();
+            spare.push_back( *item );
+        }
+        else
+        {
+            ( *item ) -> destroy();
+        }
+    }
     items.clear();
+
+    if( resultBufferCapacity > SOCK_BUFFER_KEEP_SIZE )
+    {
+        destroyResultBuffer();
+    }
+
+    resultBufferBuilded = false;
+    expectedSize = 0;
+    destroySpill();
+    return this;
+}
+
+
+
+/*
+    Cut buffer to size of message
+*/
+SockBuffer* SockBuffer::cut
+(
+    size_t          aSize,  /* Size of message */
+    vector <char>&  aRest   /* Rest */
+)
+{
+    size_t offset = 0;
+    for( auto item:items )
+    {
+        size_t readSize = item -> getReadSize();
+        if( offset + readSize > aSize )
+        {
+            auto keep = offset < aSize ? aSize - offset : 0;
+            aRest.insert
+            (
+                aRest.end(),
+                item -> getPointer() + keep,
+                item -> getPointer() + readSize
+            );
+            item -> setReadSize( keep );
+        }
+        offset += readSize;
+    }
+    resultBufferBuilded = false;
+    return this;
+}
+
+
+
+/*
+    Return count of heap and arena allocations of all buffers
+*/
+unsigned long long SockBuffer::getAllocationCount()
+{
+    return allocationCount.load();
+}
+
+
+
+/*
+    Return count of allocations of this buffer after its creation
+*/
+unsigned long long SockBuffer::getOwnAllocationCount()
+{
+    return ownAllocationCount;
+}
+
+
+
+/*
+    Count allocation of the buffer and of all buffers
+*/
+SockBuffer* SockBuffer::countAllocation()
+{
+    allocationCount++;
+    ownAllocationCount++;
     return this;
 }
 
@@ -69,7 +200,37 @@ SockBufferItem* SockBuffer::add
 )
 {
     resultBufferBuilded = false;
-    auto result = SockBufferItem::create( aSize );
+    SockBufferItem* result = NULL;
+
+    if( spillPointer != NULL && !items.empty() && items.back() == spillTail )
+    {
+        /* Bytes received by the tail join the head view */
+        spillUsed += spillTail -> getReadSize();
+        items.front() -> setReadSize( spillUsed );
+        items.pop_back();
+    }
+
+    if( spillPointer != NULL && spillUsed < spillSize )
+    {
+        /*
+            Next part of message is read directly after the received
+            bytes, so a short recv leaves no gap in the store
+        */
+        auto size = min(( size_t ) aSize, spillSize - spillUsed );
+        result = spillTail -> setView( &spillPointer[ spillUsed ], size );
+    }
+    else if( !spare.empty() && spare.back() -> getRealSize() >= aSize )
+    {
+        /* Reuse item of previous message */
+        result = spare.back();
+        result -> setReadSize( 0 );
+        spare.pop_back();
+    }
+    else
+    {
+        countAllocation();
+        result = SockBufferItem::create( aSize, arena );
+    }
     items.push_back( result );
     return result;
 }
@@ -80,13 +241,30 @@ SockBuffer* SockBuffer::buildResultBuffer()
 {
     if( !resultBufferBuilded )
     {
-        destroyResultBuffer();
-
         /* Calculate size of buffer */
-        resultBufferSize = calcReadSize();
+        auto size = calcReadSize();
 
-        /* Create result buffer */
-        resultBuffer = new char[ resultBufferSize ];
+        if( resultBuffer == NULL || resultBufferCapacity < size )
+        {
+            destroyResultBuffer();
+
+            /* Create result buffer, spare capacity takes slightly longer messages */
+            countAllocation();
+            resultBufferCapacity = 1024;
+            while( resultBufferCapacity < size && resultBufferCapacity < 0x80000000u )
+            {
+                resultBufferCapacity <<= 1;
+            }
+            resultBufferCapacity = max( resultBufferCapacity, size );
+            resultBuffer = arena == NULL ? NULL : arena -> allocate( resultBufferCapacity );
+            resultBufferArena = resultBuffer != NULL;
+            if( !resultBufferArena )
+            {
+                resultBuffer = new char[ resultBufferCapacity ];
+            }
+        }
+
+        resultBufferSize = size;
 
         /* Collect and Destroy buffers */
         unsigned int collectedSize = 0;
@@ -119,9 +297,17 @@ SockBuffer* SockBuffer::destroyResultBuffer()
     /**/
     if( resultBuffer != NULL )
     {
-        delete [] resultBuffer;
+        if( resultBufferArena )
+        {
+            arena -> release( resultBuffer, resultBufferCapacity );
+        }
+        else
+        {
+            delete [] resultBuffer;
+        }
         resultBuffer        = NULL;
         resultBufferSize    = 0;
+        resultBufferCapacity= 0;
    }
     return this;
 }
@@ -133,6 +319,10 @@ SockBuffer* SockBuffer::destroyResultBuffer()
 */
 char* SockBuffer::getBuffer()
 {
+    if( spillPointer != NULL )
+    {
+        return spillPointer;
+    }
     buildResultBuffer();
     return resultBuffer;
 }
@@ -144,6 +334,10 @@ char* SockBuffer::getBuffer()
 */
 unsigned int SockBuffer::getBufferSize()
 {
+    if( spillPointer != NULL )
+    {
+        return calcReadSize();
+    }
     buildResultBuffer();
     return resultBufferSize;
 }
@@ -155,6 +349,10 @@ unsigned int SockBuffer::getBufferSize()
 */
 string SockBuffer::getString()
 {
+    if( spillPointer != NULL )
+    {
+        return string( spillPointer, strnlen( spillPointer, calcReadSize() ));
+    }
     buildResultBuffer();
     string result( resultBuffer );
     return result;
@@ -195,3 +393,158 @@ int SockBuffer::getItemsCount()
     return items.size();
 }
 
+
+
+/*
+    Return item by index
+*/
+SockBufferItem* SockBuffer::getItem
+(
+    int aIndex
+)
+{
+    return items[ aIndex ];
+}
+
+
+
+/*
+    Set expected full size of message
+*/
+SockBuffer* SockBuffer::setExpectedSize
+(
+    size_t a
+)
+{
+    expectedSize = a;
+    return this;
+}
+
+
+
+/*
+    Return expected full size of message or 0 if unknown
+*/
+size_t SockBuffer::getExpectedSize()
+{
+    return expectedSize;
+}
+
+
+
+/*
+    Move buffer to memfd store of the full message size
+*/
+SockBuffer* SockBuffer::spill
+(
+    size_t aSize    /* Full size of message */
+)
+{
+    auto readSize = calcReadSize();
+
+    if( spillPointer == NULL && aSize >= readSize )
+    {
+        spillHandle = memfd_create( "sock_buffer", MFD_CLOEXEC );
+        if( spillHandle > -1 && ftruncate( spillHandle, aSize ) == 0 )
+        {
+            auto pointer = mmap
+            (
+                NULL,
+                aSize,
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED,
+                spillHandle,
+                0
+            );
+            if( pointer != MAP_FAILED )
+            {
+                countAllocation();
+                spillPointer = ( char* ) pointer;
+                spillSize = aSize;
+            }
+        }
+
+        if( spillPointer != NULL )
+        {
+            /* Collect readed items to the store */
+            spillUsed = 0;
+            for( auto item:items )
+            {
+                memcpy
+                (
+                    &spillPointer[ spillUsed ],
+                    item -> getPointer(),
+                    item -> getReadSize()
+                );
+                spillUsed += item -> getReadSize();
+                item -> destroy();
+            }
+            items.clear();
+
+            /* Head view grows with received bytes, tail view is reused by recv */
+            countAllocation();
+            auto item = SockBufferItem::createView( spillPointer, spillSize );
+            item -> setReadSize( spillUsed );
+            items.push_back( item );
+            countAllocation();
+            spillTail = SockBufferItem::createView( spillPointer, 0 );
+
+            destroyResultBuffer();
+            resultBufferBuilded = false;
+        }
+        else
+        {
+            /* Stay on heap when memfd is not available */
+            destroySpill();
+        }
+    }
+
+    return this;
+}
+
+
+
+/*
+    Unmap and close memfd store
+*/
+SockBuffer* SockBuffer::destroySpill()
+{
+    if( spillPointer != NULL )
+    {
+        munmap( spillPointer, spillSize );
+        spillPointer = NULL;
+    }
+    if( spillHandle > -1 )
+    {
+        close( spillHandle );
+        spillHandle = -1;
+    }
+    if( spillTail != NULL )
+    {
+        spillTail -> destroy();
+        spillTail = NULL;
+    }
+    spillSize = 0;
+    spillUsed = 0;
+    return this;
+}
+
+
+
+/*
+    Return true when buffer uses memfd store
+*/
+bool SockBuffer::isSpilled()
+{
+    return spillPointer != NULL;
+}
+
+
+
+/*
+    Return memfd handle of store or -1
+*/
+int SockBuffer::getSpillHandle()
+{
+    return spillPointer == NULL ? -1 : spillHandle;
+}
@@ -6,6 +6,7 @@
 
 #include "string"
 #include <vector>
+#include <atomic>
 
 #include "sock_buffer_item.h"
 
@@ -13,14 +14,39 @@
 using namespace std;
 
 
+
+#define SOCK_BUFFER_KEEP_SIZE 65536 /* Memory kept by reset for next message */
+
+
+
 class SockBuffer
 {
     private:
 
         vector <SockBufferItem*>    items;
+        vector <SockBufferItem*>    spare;              /* Items kept for reuse */
+        SockArena*                  arena               = NULL;
         char*                       resultBuffer        = NULL;
         unsigned int                resultBufferSize    = 0;
+        unsigned int                resultBufferCapacity= 0;
+        bool                        resultBufferArena   = false;
         bool                        resultBufferBuilded = false;
+        size_t                      expectedSize        = 0;
+
+        /* memfd store for oversized message */
+        int                         spillHandle         = -1;
+        char*                       spillPointer        = NULL;
+        size_t                      spillSize           = 0;
+        size_t                      spillUsed           = 0;    /* Received bytes of the head view */
+        SockBufferItem*             spillTail           = NULL; /* View for the next recv */
+
+        /* Allocations of this buffer after its creation */
+        unsigned long long          ownAllocationCount  = 0;
+
+        /*
+            Count allocation of the buffer and of all buffers
+        */
+        SockBuffer* countAllocation();
 
         /*
             Build resuld buffer before request buffer
@@ -32,11 +58,19 @@ class SockBuffer
         */
         SockBuffer* destroyResultBuffer();
 
+        /*
+            Unmap and close memfd store
+        */
+        SockBuffer* destroySpill();
+
     public:
         /*
             Constructor
         */
-        SockBuffer();
+        SockBuffer
+        (
+            SockArena*  /* Arena or NULL for heap */
+        );
 
 
 
@@ -50,7 +84,10 @@ class SockBuffer
         /*
             Create buffer
         */
-        static SockBuffer* create();
+        static SockBuffer* create
+        (
+            SockArena* = NULL   /* Arena or NULL for heap */
+        );
 
 
 
@@ -68,6 +105,43 @@ class SockBuffer
 
 
 
+        /*
+            Prepare buffer for the next message
+            Items and result buffer up to SOCK_BUFFER_KEEP_SIZE are kept
+            for reuse, so the steady read does not allocate
+        */
+        SockBuffer* reset();
+
+
+
+        /*
+            Cut buffer to size of message
+            Bytes after the size are moved to the rest
+        */
+        SockBuffer* cut
+        (
+            size_t,         /* Size of message */
+            vector <char>&  /* Rest */
+        );
+
+
+
+        /*
+            Return count of allocations of all buffers
+            Buffers, items, views, result buffers and memfd stores are
+            counted. Hook for tests and benchmarks of the read path.
+        */
+        static unsigned long long getAllocationCount();
+
+
+
+        /*
+            Return count of allocations of this buffer after its creation
+        */
+        unsigned long long getOwnAllocationCount();
+
+
+
         /*
             Create and return new buffer
         */
@@ -116,4 +190,59 @@ class SockBuffer
             Return count of items in buffer
         */
         int getItemsCount();
+
+
+
+        /*
+            Return item by index
+        */
+        SockBufferItem* getItem
+        (
+            int
+        );
+
+
+
+        /*
+            Set expected full size of message
+            Protocol sets it from onRead when header is known
+        */
+        SockBuffer* setExpectedSize
+        (
+            size_t
+        );
+
+
+
+        /*
+            Return expected full size of message or 0 if unknown
+        */
+        size_t getExpectedSize();
+
+
+
+        /*
+            Move buffer to memfd store of the full message size
+            Readed items are copied to the store, next items are views
+            of the store, so the message stays contiguous without heap
+        */
+        SockBuffer* spill
+        (
+            size_t  /* Full size of message */
+        );
+
+
+
+        /*
+            Return true when buffer uses memfd store
+        */
+        bool isSpilled();
+
+
+
+        /*
+            Return memfd handle of store or -1
+            Handle may be passed to sendfile or splice
+        */
+        int getSpillHandle();
 };
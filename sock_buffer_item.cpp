@@ -7,11 +7,40 @@
 */
 SockBufferItem::SockBufferItem
 (
-    unsigned int aSize   /* Real size */
+    unsigned int    aSize,  /* Real size */
+    SockArena*      aArena  /* Arena */
 )
 {
     realSize = aSize;
-    pointer = new char[ realSize ];
+    if( aArena != NULL )
+    {
+        pointer = aArena -> allocate( realSize );
+    }
+    if( pointer != NULL )
+    {
+        arena = aArena;
+    }
+    else
+    {
+        /* Heap when arena is not used or exhausted */
+        pointer = new char[ realSize ];
+    }
+}
+
+
+
+/*
+    Constructor of view
+*/
+SockBufferItem::SockBufferItem
+(
+    char*           aPointer,   /* Pointer */
+    unsigned int    aSize       /* Size */
+)
+{
+    pointer     = aPointer;
+    realSize    = aSize;
+    owner       = false;
 }
 
 
@@ -21,7 +50,18 @@ SockBufferItem::SockBufferItem
 */
 SockBufferItem::~SockBufferItem()
 {
-    delete [] pointer;
+    if( !owner )
+    {
+        /* View does not own the memory */
+    }
+    else if( arena != NULL )
+    {
+        arena -> release( pointer, realSize );
+    }
+    else
+    {
+        delete [] pointer;
+    }
 }
 
 
@@ -31,10 +71,25 @@ SockBufferItem::~SockBufferItem()
 */
 SockBufferItem* SockBufferItem::create
 (
-    unsigned int a  /* Size of item */
+    unsigned int    a,      /* Size of item */
+    SockArena*      aArena  /* Arena */
+)
+{
+    return new SockBufferItem( a, aArena );
+}
+
+
+
+/*
+    Create item as view of foreign memory
+*/
+SockBufferItem* SockBufferItem::createView
+(
+    char*           aPointer,   /* Pointer */
+    unsigned int    aSize       /* Size */
 )
 {
-    return new SockBufferItem( a );
+    return new SockBufferItem( aPointer, aSize );
 }
 
 
@@ -90,3 +145,33 @@ unsigned int SockBufferItem::getRealSize()
 {
     return realSize;
 }
+
+
+
+/*
+    Return true for view of foreign memory
+*/
+bool SockBufferItem::isView()
+{
+    return !owner;
+}
+
+
+
+/*
+    Move view to other part of foreign memory
+*/
+SockBufferItem* SockBufferItem::setView
+(
+    char*           aPointer,   /* Pointer */
+    unsigned int    aSize       /* Size */
+)
+{
+    if( !owner )
+    {
+        pointer     = aPointer;
+        realSize    = aSize;
+        readSize    = 0;
+    }
+    return this;
+}
@@ -1,5 +1,7 @@
 #include <cstddef>
 
+#include "sock_arena.h"
+
 /*
     Part of socket buffer after read
 */
@@ -11,6 +13,8 @@ class SockBufferItem
         char*           pointer     = NULL;
         unsigned int    realSize    = 0;        /* */
         unsigned int    readSize    = 0;
+        SockArena*      arena       = NULL;     /* Memory owner or NULL for heap */
+        bool            owner       = true;     /* Item owns the memory */
 
     public:
 
@@ -19,7 +23,19 @@ class SockBufferItem
         */
         SockBufferItem
         (
-            unsigned int    /* Real size */
+            unsigned int,   /* Real size */
+            SockArena*      /* Arena */
+        );
+
+
+
+        /*
+            Constructor of view
+        */
+        SockBufferItem
+        (
+            char*,          /* Pointer */
+            unsigned int    /* Size */
         );
 
 
@@ -36,7 +52,20 @@ class SockBufferItem
         */
         static SockBufferItem* create
         (
-            unsigned int
+            unsigned int,
+            SockArena* = NULL
+        );
+
+
+
+        /*
+            Create item as view of foreign memory
+            Memory is not released by item
+        */
+        static SockBufferItem* createView
+        (
+            char*,          /* Pointer */
+            unsigned int    /* Size */
         );
 
 
@@ -75,5 +104,24 @@ class SockBufferItem
         */
         unsigned int getRealSize();
 
+
+
+        /*
+            Return true for view of foreign memory
+        */
+        bool isView();
+
+
+
+        /*
+            Move view to other part of foreign memory
+            Read size is reset
+        */
+        SockBufferItem* setView
+        (
+            char*,          /* Pointer */
+            unsigned int    /* Size */
+        );
+
 };
 
@@ -0,0 +1,331 @@
+/*
+    Sys libraries
+*/
+#include <cstring>
+#include <cstdint>
+
+/*
+    Local libraries
+*/
+#include "sock_compress.h"
+
+
+
+/*
+    Read 4 bytes for matching
+*/
+static uint32_t read32
+(
+    const char* aPointer
+)
+{
+    uint32_t result;
+    memcpy( &result, aPointer, sizeof( result ));
+    return result;
+}
+
+
+
+/*
+    Write extra bytes of length over 15
+    Return false when destination is over
+*/
+static bool putLength
+(
+    char*&  aPointer,   /* Destination pointer */
+    char*   aEnd,       /* End of destination */
+    size_t  aLength     /* Length over 15 */
+)
+{
+    while( aLength >= 255 )
+    {
+        if( aPointer >= aEnd )
+        {
+            return false;
+        }
+        *aPointer++ = ( char ) 255;
+        aLength -= 255;
+    }
+
+    if( aPointer >= aEnd )
+    {
+        return false;
+    }
+    *aPointer++ = ( char ) aLength;
+    return true;
+}
+
+
+
+/*
+    Read extra bytes of length
+    Return false when source is over
+*/
+static bool getLength
+(
+    const char*&    aPointer,   /* Source pointer */
+    const char*     aEnd,       /* End of source */
+    size_t&         aLength     /* Length */
+)
+{
+    unsigned char byte = 255;
+    while( byte == 255 )
+    {
+        if( aPointer >= aEnd )
+        {
+            return false;
+        }
+        byte = ( unsigned char ) *aPointer++;
+        aLength += byte;
+    }
+    return true;
+}
+
+
+
+/*
+    Write sequence of literals and match
+    Match length 0 is for the last sequence without match
+    Return false when destination is over
+*/
+static bool putSequence
+(
+    char*&          aPointer,       /* Destination pointer */
+    char*           aEnd,           /* End of destination */
+    const char*     aLiterals,      /* Literals */
+    size_t          aLiteralsSize,  /* Count of literals */
+    size_t          aOffset,        /* Match offset */
+    size_t          aMatchSize      /* Match length */
+)
+{
+    if( aPointer >= aEnd )
+    {
+        return false;
+    }
+
+    auto matchCode = aMatchSize == 0 ? 0 : aMatchSize - COMPRESS_MATCH_MIN;
+    auto token = aPointer++;
+    *token =
+    ( char )
+    (
+        (( aLiteralsSize < 15 ? aLiteralsSize : 15 ) << 4 ) |
+        ( matchCode < 15 ? matchCode : 15 )
+    );
+
+    if( aLiteralsSize >= 15 && !putLength( aPointer, aEnd, aLiteralsSize - 15 ))
+    {
+        return false;
+    }
+
+    if(( size_t )( aEnd - aPointer ) < aLiteralsSize )
+    {
+        return false;
+    }
+    if( aLiteralsSize > 0 )
+    {
+        memcpy( aPointer, aLiterals, aLiteralsSize );
+        aPointer += aLiteralsSize;
+    }
+
+    if( aMatchSize > 0 )
+    {
+        if( aEnd - aPointer < 2 )
+        {
+            return false;
+        }
+        *aPointer++ = ( char )( aOffset & 0xFF );
+        *aPointer++ = ( char )( aOffset >> 8 );
+
+        if( matchCode >= 15 && !putLength( aPointer, aEnd, matchCode - 15 ))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+/*
+    Compress source to destination
+*/
+size_t SockCompress::compress
+(
+    const char* aSource,        /* Source */
+    size_t      aSourceSize,    /* Source size */
+    char*       aDestination,   /* Destination */
+    size_t      aCapacity       /* Destination capacity */
+)
+{
+    /* Last positions of 4 bytes sequences */
+    uint32_t table[ 1 << COMPRESS_HASH_BITS ];
+    memset( table, 0, sizeof( table ));
+
+    auto pointer = aDestination;
+    auto end = aDestination + aCapacity;
+
+    size_t anchor = 0;
+    size_t i = 1;
+    auto limit =
+    aSourceSize > COMPRESS_TAIL_SIZE + COMPRESS_MATCH_MIN
+    ? aSourceSize - COMPRESS_TAIL_SIZE - COMPRESS_MATCH_MIN
+    : 0;
+
+    while( i < limit )
+    {
+        auto sequence = read32( &aSource[ i ] );
+        auto hash = ( sequence * 2654435761u ) >> ( 32 - COMPRESS_HASH_BITS );
+        size_t reference = table[ hash ];
+        table[ hash ] = ( uint32_t ) i;
+
+        if
+        (
+            i - reference <= COMPRESS_OFFSET_MAX &&
+            read32( &aSource[ reference ] ) == sequence
+        )
+        {
+            /* Extend match up to the tail */
+            size_t matchSize = COMPRESS_MATCH_MIN;
+            auto matchEnd = aSourceSize - COMPRESS_TAIL_SIZE;
+            while
+            (
+                i + matchSize < matchEnd &&
+                aSource[ reference + matchSize ] == aSource[ i + matchSize ]
+            )
+            {
+                matchSize++;
+            }
+
+            if
+            (
+                !putSequence
+                (
+                    pointer,
+                    end,
+                    &aSource[ anchor ],
+                    i - anchor,
+                    i - reference,
+                    matchSize
+                )
+            )
+            {
+                return 0;
+            }
+
+            i += matchSize;
+            anchor = i;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    /* Rest of source is literals */
+    if
+    (
+        !putSequence
+        (
+            pointer,
+            end,
+            &aSource[ anchor ],
+            aSourceSize - anchor,
+            0,
+            0
+        )
+    )
+    {
+        return 0;
+    }
+
+    return pointer - aDestination;
+}
+
+
+
+/*
+    Decompress source to destination
+*/
+bool SockCompress::decompress
+(
+    const char* aSource,            /* Source */
+    size_t      aSourceSize,        /* Source size */
+    char*       aDestination,       /* Destination */
+    size_t      aDestinationSize    /* Destination size */
+)
+{
+    auto pointer = aSource;
+    auto sourceEnd = aSource + aSourceSize;
+    size_t written = 0;
+
+    while( pointer < sourceEnd )
+    {
+        auto token = ( unsigned char ) *pointer++;
+
+        /* Literals */
+        size_t literalsSize = token >> 4;
+        if( literalsSize == 15 && !getLength( pointer, sourceEnd, literalsSize ))
+        {
+            return false;
+        }
+        if
+        (
+            ( size_t )( sourceEnd - pointer ) < literalsSize ||
+            aDestinationSize - written < literalsSize
+        )
+        {
+            return false;
+        }
+        if( literalsSize > 0 )
+        {
+            memcpy( &aDestination[ written ], pointer, literalsSize );
+            pointer += literalsSize;
+            written += literalsSize;
+        }
+
+        /* The last sequence has no match */
+        if( pointer == sourceEnd )
+        {
+            break;
+        }
+
+        /* Match */
+        if( sourceEnd - pointer < 2 )
+        {
+            return false;
+        }
+        size_t offset =
+        ( size_t )( unsigned char ) pointer[ 0 ] |
+        (( size_t )( unsigned char ) pointer[ 1 ] << 8 );
+        pointer += 2;
+
+        size_t matchSize = token & 0x0F;
+        if( matchSize == 15 && !getLength( pointer, sourceEnd, matchSize ))
+        {
+            return false;
+        }
+        matchSize += COMPRESS_MATCH_MIN;
+
+        if
+        (
+            offset == 0 ||
+            offset > written ||
+            aDestinationSize - written < matchSize
+        )
+        {
+            return false;
+        }
+
+        /* Match may overlap own output */
+        auto from = &aDestination[ written - offset ];
+        auto to = &aDestination[ written ];
+        for( size_t j = 0; j < matchSize; j++ )
+        {
+            to[ j ] = from[ j ];
+        }
+        written += matchSize;
+    }
+
+    return written == aDestinationSize;
+}
@@ -0,0 +1,61 @@
+/*
+    Fast LZ compression for RPC payloads
+    Built-in LZ77 codec with the block layout of LZ4: each sequence is
+    a token (literals count and match length nibbles), literals, 2 bytes
+    little endian offset and extra bytes of lengths. The last sequence
+    has literals only. Codec has no state between calls and no external
+    dependencies, it is fast enough for ParamList data and keeps the
+    wire format owned by the library.
+*/
+
+#pragma once
+
+
+
+#include <cstddef>
+
+
+
+using namespace std;
+
+
+
+#define COMPRESS_HASH_BITS      12      /* 4096 positions in hash table */
+#define COMPRESS_MATCH_MIN      4       /* Minimum length of match */
+#define COMPRESS_OFFSET_MAX     65535   /* Maximum distance of match */
+#define COMPRESS_TAIL_SIZE      5       /* Last bytes are literals always */
+
+
+
+class SockCompress
+{
+    public:
+
+        /*
+            Compress source to destination
+            Return count of compressed bytes or 0 when destination
+            capacity is not enough
+        */
+        static size_t compress
+        (
+            const char*,    /* Source */
+            size_t,         /* Source size */
+            char*,          /* Destination */
+            size_t          /* Destination capacity */
+        );
+
+
+
+        /*
+            Decompress source to destination
+            Return false on corrupted data or when result size is not
+            equal to destination size
+        */
+        static bool decompress
+        (
+            const char*,    /* Source */
+            size_t,         /* Source size */
+            char*,          /* Destination */
+            size_t          /* Destination size */
+        );
+};
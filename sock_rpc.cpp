@@ -1,4 +1,6 @@
 #include "sock_rpc.h"
+#include "sock_compress.h"
+#include "../core/utils.h"
 
 #include <iostream>
 #include <cstring>
@@ -8,6 +10,10 @@ using namespace std;
 
 
 
+thread_local long long SockRpc::callDeadline = 0;
+
+
+
 /*
     Constructor
 */
@@ -70,6 +76,87 @@ Log* SockRpc::getLog()
 
 
 
+/*
+    Set log level of the RPC layer
+*/
+SockRpc* SockRpc::setLogLevel
+(
+    RpcLogLevel a
+)
+{
+    logLevel = a;
+    return this;
+}
+
+
+
+/*
+    Return log level of the RPC layer
+*/
+RpcLogLevel SockRpc::getLogLevel()
+{
+    return logLevel;
+}
+
+
+
+/*
+    Set async ring for traces
+*/
+SockRpc* SockRpc::setLogRing
+(
+    RpcLogRing* a
+)
+{
+    logRing = a;
+    return this;
+}
+
+
+
+/*
+    Return async ring for traces
+*/
+RpcLogRing* SockRpc::getLogRing()
+{
+    return logRing;
+}
+
+
+
+/*
+    Write trace with up to two integer params
+*/
+SockRpc* SockRpc::trace
+(
+    const char* aEvent,     /* Event */
+    const char* aName,      /* Name */
+    long long   aValue,     /* Value */
+    const char* aName2,     /* Second name */
+    long long   aValue2     /* Second value */
+)
+{
+    if( logRing != NULL )
+    {
+        logRing -> push( aEvent, aName, aValue, aName2, aValue2 );
+    }
+    else
+    {
+        auto log = getLog() -> trace( aEvent );
+        if( aName != NULL )
+        {
+            log -> prm( aName, aValue );
+        }
+        if( aName2 != NULL )
+        {
+            log -> prm( aName2, aValue2 );
+        }
+    }
+    return this;
+}
+
+
+
 /*
     Return current code to log
 */
@@ -84,6 +171,56 @@ SockRpc* SockRpc::resultToLog()
 
 
 
+/*
+    Set RPC header version for requests
+*/
+SockRpc* SockRpc::setRpcVersion
+(
+    unsigned char a
+)
+{
+    rpcVersion = a;
+    return this;
+}
+
+
+
+/*
+    Return RPC header version for requests
+*/
+unsigned char SockRpc::getRpcVersion()
+{
+    return rpcVersion;
+}
+
+
+
+/*
+    Set moment of the end of the current call of the thread
+*/
+void SockRpc::setCallDeadline
+(
+    long long a
+)
+{
+    callDeadline = a;
+}
+
+
+
+/*
+    Return budget of the current call of the thread in mcs
+*/
+long long SockRpc::getCallBudget()
+{
+    return
+    callDeadline == 0
+    ? -1
+    : max( callDeadline - ( long long ) now(), 0LL );
+}
+
+
+
 /******************************************************************************
     Events
 */
@@ -98,8 +235,11 @@ bool SockRpc::onReadBefore
     string aIp
 )
 {
-    getLog()
-    -> trace( "RPC Reading" );
+    /* Line of the read is written by onReadAfter for the ring */
+    if( isLogLevel( RLL_TRACE ) && logRing == NULL )
+    {
+        getLog() -> trace( "RPC Reading" );
+    }
     return true;
 }
 
@@ -116,8 +256,18 @@ bool SockRpc::onRead
 )
 {
     auto header = SockRpcHeader::create( aBuffer );
-    getLog() -> write( "." );
-    return header.isValid() && !header.isFull( aBuffer );
+    if( isLogLevel( RLL_TRACE ) && logRing == NULL )
+    {
+        getLog() -> write( "." );
+    }
+    if( header.isValid() )
+    {
+        /* Let adaptive packet size read the rest of message at once */
+        aBuffer -> setExpectedSize( header.getFullSize() );
+    }
+    return
+    header.isPartial() ||
+    ( header.isValid() && !header.isFull( aBuffer ));
 }
 
 
@@ -128,7 +278,17 @@ bool SockRpc::onReadAfter
     int
 )
 {
-    getLog() -> prm( "bytes", (int)aBuffer -> calcReadSize()) -> lineEnd();
+    if( isLogLevel( RLL_TRACE ))
+    {
+        if( logRing == NULL )
+        {
+            getLog() -> prm( "bytes", (int)aBuffer -> calcReadSize()) -> lineEnd();
+        }
+        else
+        {
+            trace( "RPC read", "bytes", aBuffer -> calcReadSize() );
+        }
+    }
     return true;
 }
 
@@ -200,8 +360,9 @@ SockRpc* SockRpc::onConnectAfter()
 */
 SockRpc* SockRpc::write
 (
-    ParamList* aParams,    /* ParamList for writing */
-    int aHandle            /* Handle for writing */
+    ParamList*      aParams,    /* ParamList for writing */
+    int             aHandle,    /* Handle for writing */
+    SockRpcHeader   aHeader     /* Header */
 )
 {
     /* Build answer buffer */
@@ -209,31 +370,183 @@ SockRpc* SockRpc::write
     size_t bufferSize = 0;
     aParams -> toBuffer( buffer, bufferSize );
 
+    writePayload( buffer, bufferSize, aHandle, aHeader );
+
+    ::operator delete( buffer );
+
+    return this;
+}
+
+
+
+/*
+    Write serialized params to socket with RPC header
+*/
+SockRpc* SockRpc::writePayload
+(
+    const void*     aPayload,       /* Serialized ParamList */
+    size_t          aPayloadSize,   /* Size of payload */
+    int             aHandle,        /* Handle for writing */
+    SockRpcHeader   aHeader         /* Header */
+)
+{
+    auto buffer = aPayload;
+    auto bufferSize = aPayloadSize;
+
     /* Create net header */
-    auto header = SockRpcHeader::create( bufferSize );
+    auto header = SockRpcHeader::create
+    (
+        bufferSize,
+        aHeader.isValid() ? aHeader.version : rpcVersion
+    );
+    header.flags        = aHeader.flags;
+    header.methodId     = aHeader.methodId;
+    header.requestId    = aHeader.requestId;
+    header.setDeadline( aHeader.deadlineMcs );
+
+    /* Compressed payload goes instead of raw one */
+    const void* payload = buffer;
+    if( pack( buffer, bufferSize, header, packed ))
+    {
+        payload = packed.data();
+    }
 
-    /* Calculate size of buffer */
-    size_t netBufferSize = header.getFullSize();
+    /* Header is built on the stack and written before the payload */
+    char head[ RPC_HEADER_MAX_SIZE ];
+    iovec parts[ 2 ];
+    parts[ 0 ].iov_base = head;
+    parts[ 0 ].iov_len  = header.write( head );
+    parts[ 1 ].iov_base = ( void* ) payload;
+    parts[ 1 ].iov_len  = header.argumentsSize;
 
-    /* Create memory for net buffer */
-    char* netBuffer = new char[ netBufferSize ];
+    /* Payload is held while writing */
+    auto heldSize = header.getFullSize();
 
-    /* Buld buffer */
-    unsigned int shift = 0;
-    memcpy( &netBuffer[ shift ], &header, sizeof( SockRpcHeader ));
-    shift += sizeof( SockRpcHeader );
-    memcpy( &netBuffer[ shift ], (void*) buffer, bufferSize );
+    if( !reserveBudget( heldSize ))
+    {
+        auto error = Result::create( "SocketWriteOverBudget" );
+        error -> getDetails()
+        -> setInt( "size", heldSize )
+        -> setInt( "connectionBudget", getConnectionBudget() );
+        onWriteError( error );
+        error -> destroy();
+    }
+    else
+    {
+        writeParts( parts, 2, aHandle );
 
-    /* Write to socket */
-    Sock::write( netBuffer, netBufferSize, aHandle );
+        if( isLogLevel( RLL_TRACE ))
+        {
+            trace( "RPC writed", "size bt", heldSize );
+        }
 
-    getLog()
-    -> trace( "RPC writed" )
-    -> prm( "size bt", ( int )netBufferSize );
+        releaseBudget( heldSize );
+    }
 
-    /* Free memory */
-    delete [] netBuffer;
-    ::operator delete( buffer );
+    return this;
+}
+
+
+
+/*
+    Write list of params to socket with one send
+*/
+SockRpc* SockRpc::writeBatch
+(
+    vector <ParamList*>&        aParams,    /* List of ParamList */
+    vector <SockRpcHeader>&     aHeaders,   /* Headers */
+    int                         aHandle     /* Handle for writing */
+)
+{
+    auto count = min( aParams.size(), aHeaders.size() );
+
+    /* Build payload buffers and net headers */
+    vector <void*> buffers( count, NULL );
+    vector <size_t> bufferSizes( count, 0 );
+    vector <SockRpcHeader> headers( count );
+    vector <vector <char>> packs( count );
+    size_t netBufferSize = 0;
+    size_t heldSize = 0;
+    size_t overSize = 0;
+
+    for( size_t i = 0; i < count; i++ )
+    {
+        aParams[ i ] -> toBuffer( buffers[ i ], bufferSizes[ i ] );
+
+        auto& header = headers[ i ];
+        header = SockRpcHeader::create
+        (
+            bufferSizes[ i ],
+            aHeaders[ i ].isValid() ? aHeaders[ i ].version : rpcVersion
+        );
+        header.flags        = aHeaders[ i ].flags;
+        header.methodId     = aHeaders[ i ].methodId;
+        header.requestId    = aHeaders[ i ].requestId;
+        header.setDeadline( aHeaders[ i ].deadlineMcs );
+
+        if( pack( buffers[ i ], bufferSizes[ i ], header, packs[ i ] ))
+        {
+            ::operator delete( buffers[ i ] );
+            buffers[ i ] = NULL;
+        }
+
+        netBufferSize += header.getFullSize();
+
+        /* Each frame is held as by writePayload */
+        if( overSize == 0 )
+        {
+            if( reserveBudget( header.getFullSize() ))
+            {
+                heldSize += header.getFullSize();
+            }
+            else
+            {
+                overSize = header.getFullSize();
+            }
+        }
+    }
+
+    if( overSize > 0 )
+    {
+        releaseBudget( heldSize );
+        auto error = Result::create( "SocketWriteOverBudget" );
+        error -> getDetails()
+        -> setInt( "size", overSize )
+        -> setInt( "connectionBudget", getConnectionBudget() );
+        onWriteError( error );
+        error -> destroy();
+    }
+    else
+    {
+        /* Headers of frames and parts of one write */
+        vector <char> heads( count * RPC_HEADER_MAX_SIZE );
+        vector <iovec> parts( count * 2 );
+        for( size_t i = 0; i < count; i++ )
+        {
+            auto& header = headers[ i ];
+            auto head = &heads[ i * RPC_HEADER_MAX_SIZE ];
+            parts[ i * 2 ].iov_base     = head;
+            parts[ i * 2 ].iov_len      = header.write( head );
+            parts[ i * 2 + 1 ].iov_base =
+            buffers[ i ] == NULL ? packs[ i ].data() : buffers[ i ];
+            parts[ i * 2 + 1 ].iov_len  = header.argumentsSize;
+        }
+
+        /* Write to socket */
+        writeParts( parts.data(), parts.size(), aHandle );
+
+        if( isLogLevel( RLL_TRACE ))
+        {
+            trace( "RPC batch writed", "count", count, "size bt", netBufferSize );
+        }
+
+        releaseBudget( heldSize );
+    }
+
+    for( auto buffer : buffers )
+    {
+        ::operator delete( buffer );
+    }
 
     return this;
 }
@@ -245,19 +558,209 @@ SockRpc* SockRpc::write
 */
 
 
+
+/*
+    Return unsigned little endian value from buffer
+*/
+static unsigned long long getLittleEndian
+(
+    const char*     aBuffer,    /* Buffer */
+    unsigned int    aSize       /* Count of bytes */
+)
+{
+    unsigned long long result = 0;
+    for( unsigned int i = 0; i < aSize; i++ )
+    {
+        result |= (( unsigned long long )( unsigned char ) aBuffer[ i ] ) << ( i * 8 );
+    }
+    return result;
+}
+
+
+
+/*
+    Put unsigned little endian value to buffer
+*/
+static void putLittleEndian
+(
+    char*               aBuffer,    /* Buffer */
+    unsigned long long  aValue,     /* Value */
+    unsigned int        aSize       /* Count of bytes */
+)
+{
+    for( unsigned int i = 0; i < aSize; i++ )
+    {
+        aBuffer[ i ] = ( char )(( aValue >> ( i * 8 )) & 0xFF );
+    }
+}
+
+
+
+/*
+    Compress payload to store
+*/
+bool SockRpc::pack
+(
+    const void*     aPayload,       /* Payload */
+    size_t          aPayloadSize,   /* Payload size */
+    SockRpcHeader&  aHeader,        /* Header */
+    vector <char>&  aStore          /* Store */
+)
+{
+    bool result = false;
+
+    /* Header asks for compression, payload is raw until it is packed */
+    bool compress = aHeader.flags & RPC_FLAG_COMPRESSED;
+    aHeader.flags &= ~RPC_FLAG_COMPRESSED;
+
+    if( aHeader.version == RPC_VERSION_2 && compressionThreshold > 0 )
+    {
+        aHeader.flags |= RPC_FLAG_ACCEPT_COMPRESSED;
+
+        if
+        (
+            compress &&
+            aPayloadSize >= compressionThreshold &&
+            aPayloadSize > RPC_COMPRESSED_PREFIX_SIZE
+        )
+        {
+            /* Compressed payload must be smaller than raw one */
+            auto capacity = aPayloadSize - RPC_COMPRESSED_PREFIX_SIZE;
+            aStore.resize( aPayloadSize );
+            putLittleEndian( aStore.data(), aPayloadSize, RPC_COMPRESSED_PREFIX_SIZE );
+            auto size = SockCompress::compress
+            (
+                ( const char* ) aPayload,
+                aPayloadSize,
+                &aStore[ RPC_COMPRESSED_PREFIX_SIZE ],
+                capacity - 1
+            );
+
+            if( size > 0 )
+            {
+                aStore.resize( RPC_COMPRESSED_PREFIX_SIZE + size );
+                aHeader.argumentsSize = aStore.size();
+                aHeader.flags |= RPC_FLAG_COMPRESSED;
+                result = true;
+            }
+        }
+    }
+
+    return result;
+}
+
+
+
+/*
+    Return payload of frame and its size
+*/
+char* SockRpc::getPayload
+(
+    SockBuffer*     aBuffer,    /* Buffer of frame */
+    SockRpcHeader&  aHeader,    /* Header of frame */
+    size_t&         aSize       /* Return payload size */
+)
+{
+    /* Frame must be in the buffer whole */
+    char* result = NULL;
+    aSize = 0;
+    if( aHeader.getFullSize() <= aBuffer -> getBufferSize() )
+    {
+        result = &aBuffer -> getBuffer()[ aHeader.getHeaderSize() ];
+        aSize = aHeader.argumentsSize;
+    }
+
+    if( result != NULL && ( aHeader.flags & RPC_FLAG_COMPRESSED ))
+    {
+        size_t rawSize =
+        aSize < RPC_COMPRESSED_PREFIX_SIZE
+        ? 0
+        : getLittleEndian( result, RPC_COMPRESSED_PREFIX_SIZE );
+
+        /* LZ sequence can not expand more than 255 times */
+        auto connectionBudget = getConnectionBudget();
+        bool valid =
+        aSize > RPC_COMPRESSED_PREFIX_SIZE &&
+        rawSize / 255 <= aSize &&
+        ( connectionBudget == 0 || rawSize <= connectionBudget );
+
+        if( valid )
+        {
+            unpacked.resize( rawSize );
+            valid = SockCompress::decompress
+            (
+                &result[ RPC_COMPRESSED_PREFIX_SIZE ],
+                aSize - RPC_COMPRESSED_PREFIX_SIZE,
+                unpacked.data(),
+                rawSize
+            );
+        }
+
+        if( valid )
+        {
+            result = unpacked.data();
+            aSize = rawSize;
+        }
+        else
+        {
+            getLog()
+            -> warning( "Compressed payload is not valid" )
+            -> prm( "size", ( long long ) aSize )
+            -> prm( "rawSize", ( long long ) rawSize );
+            result = NULL;
+            aSize = 0;
+        }
+    }
+
+    return result;
+}
+
+
+
+/*
+    Set payload size for compression of v2 frames
+*/
+SockRpc* SockRpc::setCompressionThreshold
+(
+    size_t a
+)
+{
+    compressionThreshold = a;
+    return this;
+}
+
+
+
+/*
+    Return payload size for compression
+*/
+size_t SockRpc::getCompressionThreshold()
+{
+    return compressionThreshold;
+}
+
+
+
+/* Magic of the header v2 */
+static const char RPC_MAGIC_V2[ 4 ] = { 'R', 'P', 'v', '2' };
+
+
+
 /*
     Return filled SockRpcHeader
 */
 SockRpcHeader SockRpcHeader::create
 (
-    size_t aArgumentsSize
+    size_t          aArgumentsSize,
+    unsigned char   aVersion
 )
 {
     SockRpcHeader result;
 
-    result.prefix[ 0 ]      = 'R';
-    result.prefix[ 1 ]      = 'P';
-    result.prefix[ 2 ]      = 'C';
+    result.version          = aVersion;
+    result.headerSize       = aVersion == RPC_VERSION_2
+    ? RPC_HEADER_V2_SIZE
+    : RPC_HEADER_V1_SIZE;
     result.argumentsSize    = aArgumentsSize;
 
     return result;
@@ -267,24 +770,29 @@ SockRpcHeader SockRpcHeader::create
 
 /*
     Return filled header from buffer
+    Header may be divided between first items
 */
 SockRpcHeader SockRpcHeader::create
 (
     SockBuffer* aBuffer
 )
 {
-    SockRpcHeader result;
+    char header[ RPC_HEADER_MAX_SIZE ];
+    size_t size = 0;
 
-    auto firstBlock = aBuffer -> getFirstBuffer();
-    unsigned int headerSize = sizeof( SockRpcHeader );
-
-    if( firstBlock != NULL && firstBlock -> getReadSize() >= headerSize )
+    for( int i = 0; i < aBuffer -> getItemsCount() && size < RPC_HEADER_MAX_SIZE; i++ )
     {
-        auto pointer = firstBlock -> getPointer();
-        memcpy( &result, pointer, headerSize );
+        auto item = aBuffer -> getItem( i );
+        auto count = min
+        (
+            ( size_t ) item -> getReadSize(),
+            ( size_t ) RPC_HEADER_MAX_SIZE - size
+        );
+        memcpy( &header[ size ], item -> getPointer(), count );
+        size += count;
     }
 
-    return result;
+    return create( header, size );
 }
 
 
@@ -300,11 +808,94 @@ SockRpcHeader SockRpcHeader::create
 {
     SockRpcHeader result;
 
-    unsigned int headerSize = sizeof( SockRpcHeader );
-
-    if( aBuffer != NULL && aSize >= headerSize )
+    if( aBuffer != NULL )
     {
-        memcpy( &result, aBuffer, headerSize );
+        if( aSize >= 3 && aBuffer[ 0 ] == 'R' && aBuffer[ 1 ] == 'P' && aBuffer[ 2 ] == 'C' )
+        {
+            /* Version 1 */
+            if( aSize >= RPC_HEADER_V1_SIZE )
+            {
+                size_t argumentsSize = 0;
+                memcpy( &argumentsSize, &aBuffer[ 8 ], sizeof( size_t ));
+                if( argumentsSize <= RPC_FRAME_MAX_SIZE - RPC_HEADER_V1_SIZE )
+                {
+                    result.version = RPC_VERSION_1;
+                    result.headerSize = RPC_HEADER_V1_SIZE;
+                    result.argumentsSize = argumentsSize;
+                }
+            }
+            else
+            {
+                result.partial = true;
+            }
+        }
+        else if
+        (
+            aSize >= sizeof( RPC_MAGIC_V2 ) &&
+            memcmp( aBuffer, RPC_MAGIC_V2, sizeof( RPC_MAGIC_V2 )) == 0
+        )
+        {
+            /* Version 2 */
+            auto version = aSize > 4
+            ? ( unsigned char ) aBuffer[ 4 ]
+            : ( unsigned char ) RPC_VERSION_2;
+            auto headerSize = aSize > 5
+            ? ( size_t )( unsigned char ) aBuffer[ 5 ]
+            : ( size_t ) RPC_HEADER_V2_SIZE;
+
+            if
+            (
+                version != RPC_VERSION_2 ||
+                headerSize < RPC_HEADER_V2_SIZE ||
+                headerSize > RPC_HEADER_MAX_SIZE
+            )
+            {
+                /*
+                    Header is not valid and never becomes full, the
+                    buffer collects at most RPC_HEADER_MAX_SIZE bytes
+                */
+            }
+            else if( aSize < headerSize )
+            {
+                result.partial = true;
+            }
+            else if
+            (
+                getLittleEndian( &aBuffer[ 24 ], 8 ) >
+                RPC_FRAME_MAX_SIZE - headerSize
+            )
+            {
+                /* Size of arguments is over the limit of frame */
+            }
+            else
+            {
+                result.version          = version;
+                result.headerSize       = headerSize;
+                result.flags            = getLittleEndian( &aBuffer[ 6 ], 2 );
+                result.methodId         = getLittleEndian( &aBuffer[ 8 ], 4 );
+                result.requestId        = getLittleEndian( &aBuffer[ 16 ], 8 );
+                result.argumentsSize    = getLittleEndian( &aBuffer[ 24 ], 8 );
+                if
+                (
+                    ( result.flags & RPC_FLAG_DEADLINE ) &&
+                    headerSize >= RPC_HEADER_DEADLINE_SIZE
+                )
+                {
+                    result.deadlineMcs = getLittleEndian( &aBuffer[ 32 ], 8 );
+                }
+            }
+        }
+        else
+        {
+            /* Begin of magic */
+            result.partial =
+            aSize > 0 &&
+            aSize < sizeof( RPC_MAGIC_V2 ) &&
+            (
+                memcmp( aBuffer, RPC_MAGIC_V2, aSize ) == 0 ||
+                memcmp( aBuffer, "RPC", min( aSize, ( size_t ) 3 )) == 0
+            );
+        }
     }
 
     return result;
@@ -312,12 +903,57 @@ SockRpcHeader SockRpcHeader::create
 
 
 
+/*
+    Write header to memory buffer in wire format
+*/
+size_t SockRpcHeader::write
+(
+    char* aBuffer   /* Buffer */
+)
+{
+    if( version == RPC_VERSION_2 )
+    {
+        memcpy( aBuffer, RPC_MAGIC_V2, sizeof( RPC_MAGIC_V2 ));
+        putLittleEndian( &aBuffer[ 4 ], version, 1 );
+        putLittleEndian( &aBuffer[ 5 ], headerSize, 1 );
+        putLittleEndian( &aBuffer[ 6 ], flags, 2 );
+        putLittleEndian( &aBuffer[ 8 ], methodId, 4 );
+        putLittleEndian( &aBuffer[ 12 ], 0, 4 );
+        putLittleEndian( &aBuffer[ 16 ], requestId, 8 );
+        putLittleEndian( &aBuffer[ 24 ], argumentsSize, 8 );
+        /* Extension bytes are zero */
+        memset( &aBuffer[ RPC_HEADER_V2_SIZE ], 0, headerSize - RPC_HEADER_V2_SIZE );
+        if( flags & RPC_FLAG_DEADLINE )
+        {
+            putLittleEndian( &aBuffer[ 32 ], deadlineMcs, 8 );
+        }
+    }
+    else
+    {
+        memcpy( aBuffer, "RPCNOVIN", 8 );
+        memcpy( &aBuffer[ 8 ], &argumentsSize, sizeof( size_t ));
+    }
+    return getHeaderSize();
+}
+
+
+
 /*
     Check valid of SockRpcHeader
 */
 bool SockRpcHeader::isValid()
 {
-    return prefix[ 0 ] == 'R' && prefix[ 1 ] == 'P' && prefix[ 2 ] == 'C';
+    return version == RPC_VERSION_1 || version == RPC_VERSION_2;
+}
+
+
+
+/*
+    Return true when buffer begins like header but is shorter than it
+*/
+bool SockRpcHeader::isPartial()
+{
+    return partial;
 }
 
 
@@ -335,10 +971,47 @@ bool SockRpcHeader::isFull
 
 
 
+/*
+    Set budget of the call for v2 header
+    Version 1 has no place for the deadline, it is ignored
+*/
+SockRpcHeader& SockRpcHeader::setDeadline
+(
+    unsigned long long a
+)
+{
+    if( version == RPC_VERSION_2 )
+    {
+        deadlineMcs = a;
+        if( a > 0 )
+        {
+            flags |= RPC_FLAG_DEADLINE;
+            headerSize = max( headerSize, ( size_t ) RPC_HEADER_DEADLINE_SIZE );
+        }
+        else
+        {
+            flags &= ~RPC_FLAG_DEADLINE;
+        }
+    }
+    return *this;
+}
+
+
+
+/*
+    Return size of header on wire
+*/
+size_t SockRpcHeader::getHeaderSize()
+{
+    return headerSize;
+}
+
+
+
 /*
     Return full size of rpc
 */
 size_t SockRpcHeader::getFullSize()
 {
-    return sizeof( SockRpcHeader ) + argumentsSize;
+    return headerSize + argumentsSize;
 }
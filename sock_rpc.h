@@ -13,6 +13,100 @@
 #include "../json/param_list.h"
 #include "../core/log_manager.h"
 
+#include "rpc_log_ring.h"
+
+
+
+/*
+    RPC header versions
+    Version 1 is the legacy header: 8 bytes prefix "RPCNOVIN" and native
+    size_t of arguments size.
+    Version 2 is fixed little endian header:
+        0   4   magic "RPv2"
+        4   1   version
+        5   1   header size
+        6   2   flags
+        8   4   method id
+        12  4   reserved
+        16  8   request id
+        24  8   arguments size
+    Header size is RPC_HEADER_V2_SIZE..RPC_HEADER_MAX_SIZE, the header
+    with other size or version is not valid.
+    Header of both versions is not valid when the frame with arguments
+    is over RPC_FRAME_MAX_SIZE, so the size from the wire never wraps.
+    The v2 magic is not valid for v1 peers, so the server answers with
+    the version of the request and v1 clients keep working.
+*/
+#define RPC_VERSION_1           1
+#define RPC_VERSION_2           2
+#define RPC_HEADER_V1_SIZE      ( 8 + sizeof( size_t ))
+#define RPC_HEADER_V2_SIZE      32
+#define RPC_HEADER_MAX_SIZE     64
+#define RPC_FRAME_MAX_SIZE      0x40000000  /* Hard limit of frame, 1 GiB */
+
+
+
+/*
+    RPC v2 header flags
+    Streamed answer is a sequence of frames with RPC_FLAG_STREAM and
+    the request id, the last frame has RPC_FLAG_STREAM_END as well.
+    Request with RPC_FLAG_STREAM asks for the streamed answer.
+*/
+#define RPC_FLAG_STREAM         0x0001
+#define RPC_FLAG_STREAM_END     0x0002
+
+/*
+    Compression flags
+    Peer with compression sets RPC_FLAG_ACCEPT_COMPRESSED on own frames,
+    the other side may compress frames for it after that. Compressed
+    payload has RPC_FLAG_COMPRESSED, 8 bytes little endian of the raw
+    size and the block of SockCompress.
+*/
+#define RPC_FLAG_ACCEPT_COMPRESSED  0x0004
+#define RPC_FLAG_COMPRESSED         0x0008
+#define RPC_COMPRESSED_PREFIX_SIZE  8
+
+/*
+    Deadline of the call
+    Request with RPC_FLAG_DEADLINE has 8 bytes little endian extension
+    at offset 32: budget of the call in microseconds. Budget is relative,
+    so clocks of peers are not synchronized, the server counts it from
+    receipt of the request and answers RPC_DEADLINE_EXCEEDED without the
+    handler call when the budget is over before dequeue.
+*/
+#define RPC_FLAG_DEADLINE           0x0010
+#define RPC_HEADER_DEADLINE_SIZE    ( RPC_HEADER_V2_SIZE + 8 )
+#define RPC_DEADLINE_EXCEEDED       "deadline_exceeded"
+
+/*
+    Typed payload
+    Request with RPC_FLAG_TYPED carries the struct encoded by RpcTyped
+    instead of ParamList and is routed by method id only. The answer
+    has the flag when it is the typed struct, error answers are
+    ParamList with the result code.
+*/
+#define RPC_FLAG_TYPED              0x0020
+
+
+
+/*
+    Log level of the RPC layer
+    Traces of the hot path are written only for the level of the
+    socket, the arguments of the disabled trace are not evaluated.
+    Warnings are written always. Default level is RPC_LOG_LEVEL,
+    builds may define it as RLL_WARNING for production.
+*/
+enum RpcLogLevel
+{
+    RLL_WARNING,    /* Warnings only */
+    RLL_TRACE,      /* Traces of frames */
+    RLL_DUMP        /* Traces and dumps of arguments and answers */
+};
+
+#ifndef RPC_LOG_LEVEL
+#define RPC_LOG_LEVEL RLL_DUMP
+#endif
+
 
 
 /*
@@ -20,14 +114,20 @@
 */
 struct SockRpcHeader
 {
-    /* Initialize with "hrenovin" */
-    char            prefix[ 8 ]     = { 'H', 'R', 'E', 'N', 'O', 'V', 'I', 'N' };
-    size_t          argumentsSize   = 0;
+    unsigned char       version         = 0;    /* 0 for invalid header */
+    bool                partial         = false;/* Header is not fully read yet */
+    unsigned short      flags           = 0;
+    unsigned int        methodId        = 0;
+    unsigned long long  requestId       = 0;
+    size_t              argumentsSize   = 0;
+    size_t              headerSize      = 0;
+    unsigned long long  deadlineMcs     = 0;    /* Budget of the call, 0 without deadline */
 
 
     static SockRpcHeader create
     (
-        size_t   /* argumentsSize */
+        size_t,                         /* argumentsSize */
+        unsigned char = RPC_VERSION_1   /* version */
     );
 
 
@@ -54,6 +154,13 @@ struct SockRpcHeader
 
 
 
+    /*
+        Return true when buffer begins like header but is shorter than it
+    */
+    bool isPartial();
+
+
+
     bool isFull
     (
         SockBuffer*
@@ -61,6 +168,23 @@ struct SockRpcHeader
 
 
 
+    /*
+        Set budget of the call for v2 header, 0 removes deadline
+    */
+    SockRpcHeader& setDeadline
+    (
+        unsigned long long  /* Budget mcs */
+    );
+
+
+
+    /*
+        Return size of header on wire
+    */
+    size_t getHeaderSize();
+
+
+
     /*
         Return full size of rpc
     */
@@ -68,6 +192,18 @@ struct SockRpcHeader
 
 
 
+    /*
+        Write header to memory buffer in wire format
+        Buffer must have getHeaderSize bytes
+        Return count of written bytes
+    */
+    size_t write
+    (
+        char*   /* Buffer */
+    );
+
+
+
     /*
         Return params from buffer
     */
@@ -88,6 +224,24 @@ class SockRpc : public Sock
     private:
 
         LogManager*     logManager  = NULL;
+        unsigned char   rpcVersion  = RPC_VERSION_1;    /* Version for requests */
+
+        /* Log */
+        RpcLogLevel     logLevel    = RPC_LOG_LEVEL;
+        RpcLogRing*     logRing     = NULL;             /* Async sink of traces, not owned */
+
+        /*
+            Compression
+            Buffers belong to the socket, not to the call, so frames of
+            one SockRpc are written and read by one thread at a time:
+            the listen loop for RpcServer, the owner thread for RpcClient.
+        */
+        size_t          compressionThreshold    = 0;    /* Payload size for compression, 0 is off */
+        vector <char>   packed;                         /* Compressed payload for writing */
+        vector <char>   unpacked;                       /* Decompressed payload of the last frame */
+
+        /* Moment of the end of the current call of the thread, 0 without deadline */
+        static thread_local long long callDeadline;
 
 
 
@@ -101,6 +255,21 @@ class SockRpc : public Sock
         ) final;
 
 
+
+        /*
+            Compress payload to store for v2 header with
+            RPC_FLAG_COMPRESSED and correct flags of header
+            Return true if payload was compressed
+        */
+        bool pack
+        (
+            const void*,        /* Payload */
+            size_t,             /* Payload size */
+            SockRpcHeader&,     /* Header */
+            vector <char>&      /* Store */
+        );
+
+
     public:
 
 
@@ -142,6 +311,71 @@ class SockRpc : public Sock
 
 
 
+        /*
+            Set log level of the RPC layer
+        */
+        SockRpc* setLogLevel
+        (
+            RpcLogLevel
+        );
+
+
+
+        /*
+            Return log level of the RPC layer
+        */
+        RpcLogLevel getLogLevel();
+
+
+
+        /*
+            Return true when traces of the level are written
+            Check it before building of trace arguments
+        */
+        inline bool isLogLevel
+        (
+            RpcLogLevel aLevel
+        )
+        {
+            return aLevel <= logLevel;
+        }
+
+
+
+        /*
+            Set async ring for traces
+            Traces go to the ring instead of the log, dumps are not
+            written with the ring. NULL returns traces to the log.
+        */
+        SockRpc* setLogRing
+        (
+            RpcLogRing*
+        );
+
+
+
+        /*
+            Return async ring for traces
+        */
+        RpcLogRing* getLogRing();
+
+
+
+        /*
+            Write trace with up to two integer params
+            Event and names must be string literals for the ring
+        */
+        SockRpc* trace
+        (
+            const char*,            /* Event */
+            const char* = NULL,     /* Name */
+            long long = 0,          /* Value */
+            const char* = NULL,     /* Second name */
+            long long = 0           /* Second value */
+        );
+
+
+
         /*
             Return current code to log
         */
@@ -151,15 +385,121 @@ class SockRpc : public Sock
 
         /*
             Write buffer to socket with RPC header
+            Header gives version, flags and ids, arguments size is
+            calculated. Header without version uses rpcVersion.
         */
         SockRpc* write
         (
-            ParamList*,     /* ParamList */
-            int = -1        /* Handle for writing */
+            ParamList*,                         /* ParamList */
+            int = -1,                           /* Handle for writing */
+            SockRpcHeader = SockRpcHeader()     /* Header */
+        );
+
+
+
+        /*
+            Write serialized params to socket with RPC header
+            Payload is the result of ParamList::toBuffer, stored
+            answers are written without serialization
+        */
+        SockRpc* writePayload
+        (
+            const void*,                        /* Serialized ParamList */
+            size_t,                             /* Size of payload */
+            int = -1,                           /* Handle for writing */
+            SockRpcHeader = SockRpcHeader()     /* Header */
+        );
+
+
+
+        /*
+            Write list of params to socket with one send
+            Each params has own RPC frame with header of the same index.
+            Budgets hold each frame as writePayload does, the batch is
+            not written when one frame is over budget.
+        */
+        SockRpc* writeBatch
+        (
+            vector <ParamList*>&,       /* List of ParamList */
+            vector <SockRpcHeader>&,    /* Headers */
+            int = -1                    /* Handle for writing */
         );
 
 
 
+        /*
+            Return payload of frame and its size
+            Compressed payload is decompressed to the side buffer of
+            SockRpc, not to the receive buffer, it is valid until the
+            next frame of the socket. Return NULL for the
+            corrupted payload.
+        */
+        char* getPayload
+        (
+            SockBuffer*,        /* Buffer of frame */
+            SockRpcHeader&,     /* Header of frame */
+            size_t&             /* Return payload size */
+        );
+
+
+
+        /*
+            Set payload size for compression of v2 frames
+            0 turns compression off. Compression is used when the
+            peer accepts compressed frames.
+        */
+        SockRpc* setCompressionThreshold
+        (
+            size_t
+        );
+
+
+
+        /*
+            Return payload size for compression
+        */
+        size_t getCompressionThreshold();
+
+
+
+        /*
+            Set RPC header version for requests
+            RPC_VERSION_1 is default for compatibility with old servers
+        */
+        SockRpc* setRpcVersion
+        (
+            unsigned char
+        );
+
+
+
+        /*
+            Return RPC header version for requests
+        */
+        unsigned char getRpcVersion();
+
+
+
+        /*
+            Set moment of the end of the current call of the thread
+            Server sets it for handlers, 0 without deadline
+        */
+        static void setCallDeadline
+        (
+            long long   /* Moment mcs */
+        );
+
+
+
+        /*
+            Return budget of the current call of the thread in mcs
+            Return -1 without deadline and 0 when the budget is over.
+            Handlers may check it, clients pass it to nested calls.
+        */
+        static long long getCallBudget();
+
+
+
         /******************************************************************************
             Events
         */